@@ -0,0 +1,231 @@
+// بنچمارک تخصیص‌دهنده بلوک‌ها روی دیسک تکه‌تکه شده
+// مقایسه نسخه درختی (free_list.c) با لیست پیوندی first-fit قبلی
+//
+// ساخت و اجرا:  make bench_free_list && ./bench_free_list [تعداد دور] [تعداد بلوک]
+// (پیش‌فرض تعداد بلوک‌ها اندازه دیسک واقعی است؛ عدد بزرگ‌تر اثر تکه‌تکه شدن را بیشتر نشان می‌دهد)
+// خروجی روی stderr است؛ پیام‌های تخصیص‌دهنده به /dev/null می‌روند
+
+#include "general_fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MAX_ALLOCS 1000000
+
+// ==================== نسخه قبلی: لیست مرتب و first-fit ====================
+
+static int list_alloc(free_block_t **head, uint32_t block_count, uint32_t *start_block) {
+    free_block_t *current = *head;
+    free_block_t *prev = NULL;
+
+    while (current) {
+        if (current->block_count >= block_count) {
+            *start_block = current->start_block;
+            if (current->block_count == block_count) {
+                if (prev) {
+                    prev->next = current->next;
+                } else {
+                    *head = current->next;
+                }
+                free(current);
+            } else {
+                current->start_block += block_count;
+                current->block_count -= block_count;
+            }
+            printf("Allocated %u blocks starting at block %u\n", block_count, *start_block);
+            return 0;
+        }
+        prev = current;
+        current = current->next;
+    }
+
+    printf("Error: Not enough free blocks (needed: %u)\n", block_count);
+    return -ENOSPC;
+}
+
+static int list_free(free_block_t **head, uint32_t start_block, uint32_t block_count) {
+    printf("Freeing %u blocks starting at block %u\n", block_count, start_block);
+
+    free_block_t *new_block = calloc(1, sizeof(free_block_t));
+    if (!new_block) return -ENOMEM;
+    new_block->start_block = start_block;
+    new_block->block_count = block_count;
+
+    // درج مرتب
+    free_block_t *current = *head;
+    free_block_t *prev = NULL;
+    while (current && current->start_block < start_block) {
+        prev = current;
+        current = current->next;
+    }
+    new_block->next = current;
+    if (prev) {
+        prev->next = new_block;
+    } else {
+        *head = new_block;
+    }
+
+    // ادغام کامل لیست
+    current = *head;
+    while (current && current->next) {
+        if (current->start_block + current->block_count == current->next->start_block) {
+            free_block_t *to_delete = current->next;
+            current->block_count += to_delete->block_count;
+            current->next = to_delete->next;
+            free(to_delete);
+        } else {
+            current = current->next;
+        }
+    }
+    return 0;
+}
+
+// ==================== بار کاری ====================
+
+typedef struct {
+    uint32_t start;
+    uint32_t count;
+} bench_alloc_t;
+
+typedef struct {
+    const char *name;
+    double seconds;
+    uint64_t ops;
+    uint32_t failed;
+    uint32_t extents;
+    uint32_t largest;
+    uint32_t free_blocks;
+} bench_result_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// اندازه تصادفی: بیشتر فایل‌ها کوچک، چند فایل بزرگ
+static uint32_t random_size(void) {
+    int r = rand() % 100;
+    if (r < 70) return 1 + rand() % 4;
+    if (r < 95) return 5 + rand() % 28;
+    return 33 + rand() % 224;
+}
+
+static void summarize(free_block_t *head, bench_result_t *result) {
+    for (free_block_t *current = head; current; current = current->next) {
+        result->extents++;
+        result->free_blocks += current->block_count;
+        if (current->block_count > result->largest) {
+            result->largest = current->block_count;
+        }
+    }
+}
+
+// پر کردن دیسک تا حدود 85% و بعد rounds دور آزادسازی و تخصیص تصادفی
+static void run(int tree, uint32_t rounds, uint32_t total_blocks, unsigned seed,
+                bench_result_t *result) {
+    bench_alloc_t *allocs = calloc(BENCH_MAX_ALLOCS, sizeof(bench_alloc_t));
+    uint32_t alloc_count = 0;
+    uint32_t used = 0;
+
+    superblock_t superblock;
+    struct fs_state state;
+    memset(&superblock, 0, sizeof(superblock));
+    memset(&state, 0, sizeof(state));
+    state.superblock = &superblock;
+    fs_locks_init(&state);
+
+    free_block_t *head = NULL;
+    if (tree) {
+        // بدون bitmap گروه‌ها خالی ساخته می‌شوند و بعد کل محدوده آزاد می‌شود
+        fs_init_free_list(&state);
+        fs_free_blocks(0, total_blocks, &state);
+    } else {
+        head = calloc(1, sizeof(free_block_t));
+        head->block_count = total_blocks;
+    }
+
+    srand(seed);
+    result->name = tree ? "tree (best-fit)" : "list (first-fit)";
+
+    double start = now_seconds();
+
+    while (used < total_blocks * 85 / 100 && alloc_count < BENCH_MAX_ALLOCS) {
+        bench_alloc_t *a = &allocs[alloc_count];
+        a->count = random_size();
+        int res = tree ? fs_alloc_blocks(a->count, &state, &a->start)
+                       : list_alloc(&head, a->count, &a->start);
+        result->ops++;
+        if (res < 0) break;
+        used += a->count;
+        alloc_count++;
+    }
+
+    for (uint32_t i = 0; i < rounds && alloc_count > 0; i++) {
+        uint32_t victim = rand() % alloc_count;
+        bench_alloc_t *a = &allocs[victim];
+        if (tree) {
+            fs_free_blocks(a->start, a->count, &state);
+        } else {
+            list_free(&head, a->start, a->count);
+        }
+        result->ops++;
+
+        a->count = random_size();
+        int res = tree ? fs_alloc_blocks(a->count, &state, &a->start)
+                       : list_alloc(&head, a->count, &a->start);
+        result->ops++;
+        if (res < 0) {
+            // جا نشد: این اسلات حذف می‌شود
+            result->failed++;
+            allocs[victim] = allocs[--alloc_count];
+        }
+    }
+
+    result->seconds = now_seconds() - start;
+
+    if (tree) {
+        for (uint32_t i = 0; i < state.alloc_group_count; i++) {
+            summarize(state.alloc_groups[i].free_list, result);
+        }
+        fs_free_list_destroy(&state);
+    } else {
+        summarize(head, result);
+        while (head) {
+            free_block_t *next = head->next;
+            free(head);
+            head = next;
+        }
+    }
+    fs_locks_destroy(&state);
+    free(allocs);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t rounds = argc > 1 ? (uint32_t)atoi(argv[1]) : 200000;
+    uint32_t total_blocks = argc > 2 ? (uint32_t)atoi(argv[2]) : FS_SIZE / BLOCK_SIZE;
+    bench_result_t results[2];
+    memset(results, 0, sizeof(results));
+
+    // پیام‌های تخصیص‌دهنده در زمان‌گیری دخالت نکنند
+    if (!freopen("/dev/null", "w", stdout)) {
+        perror("freopen");
+        return 1;
+    }
+
+    run(0, rounds, total_blocks, 42, &results[0]);
+    run(1, rounds, total_blocks, 42, &results[1]);
+
+    fprintf(stderr, "=== Free List Benchmark (%u blocks, %u churn rounds) ===\n",
+            total_blocks, rounds);
+    fprintf(stderr, "%-18s %10s %10s %8s %8s %10s %10s\n",
+            "allocator", "time(s)", "ns/op", "failed", "extents", "largest", "free");
+    for (int i = 0; i < 2; i++) {
+        bench_result_t *r = &results[i];
+        fprintf(stderr, "%-18s %10.3f %10.0f %8u %8u %10u %10u\n",
+                r->name, r->seconds, r->seconds * 1e9 / r->ops,
+                r->failed, r->extents, r->largest, r->free_blocks);
+    }
+    return 0;
+}
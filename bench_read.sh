@@ -0,0 +1,52 @@
+#!/bin/bash
+# بنچمارک خواندن ترتیبی: 1 GB (فایل FILE_MB مگابایتی چند بار) با splice از image
+# در برابر کپی در بافر (-o copy_read)، روی هر دو frontend
+# استفاده: ./bench_read.sh   (FILE_MB و TOTAL_MB قابل تغییرند)
+
+FILE_MB=${FILE_MB:-64}
+TOTAL_MB=${TOTAL_MB:-1024}
+PASSES=$(( (TOTAL_MB + FILE_MB - 1) / FILE_MB ))
+
+echo "=== Benchmarking sequential read ($PASSES x $FILE_MB MB) ==="
+echo "==========================================================="
+
+make
+
+rm -f bench_read.bin
+rm -rf /tmp/bench_read
+mkdir -p /tmp/bench_read
+head -c $((FILE_MB * 1024 * 1024)) /dev/urandom > /tmp/bench_read.src
+
+# frontend سطح بالا فقط با -s از splice استفاده می‌کند
+for mode in "lowlevel splice:--lowlevel" "lowlevel copy:--lowlevel -o copy_read" \
+            "highlevel splice:-s" "highlevel copy:-s -o copy_read"; do
+    name=${mode%%:*}
+    flags=${mode#*:}
+
+    echo -e "\n--- $name ($flags) ---"
+    ./general_fs bench_read.bin /tmp/bench_read -f $flags &
+    FS_PID=$!
+    sleep 3
+
+    [ -f /tmp/bench_read/data ] || cp /tmp/bench_read.src /tmp/bench_read/data
+
+    # هر dd فایل را دوباره باز می‌کند و بدون kernel_cache کش صفحه‌ها دور ریخته
+    # می‌شود، پس همه داده واقعاً از daemon خوانده می‌شود
+    START=$(date +%s.%N)
+    for i in $(seq 1 $PASSES); do
+        dd if=/tmp/bench_read/data of=/dev/null bs=1M 2>/dev/null
+    done
+    END=$(date +%s.%N)
+
+    cmp -s /tmp/bench_read.src /tmp/bench_read/data && echo "✓ Data verified" || echo "✗ Data mismatch"
+    ELAPSED=$(echo "$END - $START" | bc)
+    echo "Time:       $ELAPSED s"
+    echo "Throughput: $(echo "$PASSES * $FILE_MB / $ELAPSED" | bc) MB/s"
+
+    fusermount -u /tmp/bench_read
+    wait $FS_PID 2>/dev/null
+done
+
+rm -f bench_read.bin /tmp/bench_read.src
+rm -rf /tmp/bench_read
+echo -e "\n=== Benchmark Complete ==="
@@ -0,0 +1,63 @@
+#!/bin/bash
+# بنچمارک ls -l روی یک دایرکتوری 1000 فایلی
+# استفاده: ./bench_readdir.sh [باینری ...]   (مثلاً نسخه قبلی برای مقایسه)
+
+N=${N:-1000}
+BINARIES=("$@")
+[ ${#BINARIES[@]} -eq 0 ] && BINARIES=(./general_fs)
+
+echo "=== Benchmarking readdir (ls -l on $N files) ==="
+echo "================================================"
+
+make
+
+for BIN in "${BINARIES[@]}"; do
+    echo -e "\n--- $BIN ---"
+    rm -f bench_readdir.bin
+    rm -rf /tmp/bench_readdir
+    mkdir -p /tmp/bench_readdir
+
+    $BIN bench_readdir.bin /tmp/bench_readdir -f &
+    FS_PID=$!
+    sleep 3
+
+    echo "Creating $N files..."
+    for i in $(seq 1 $N); do
+        : > /tmp/bench_readdir/file_$i
+    done
+
+    # کش attr کرنل خالی می‌شود تا هر بار واقعاً از فایل‌سیستم خوانده شود
+    fusermount -u /tmp/bench_readdir
+    wait $FS_PID 2>/dev/null
+    $BIN bench_readdir.bin /tmp/bench_readdir -f &
+    FS_PID=$!
+    sleep 3
+
+    # شمارش syscallهای daemon (هر درخواست FUSE یک read روی /dev/fuse است)
+    if command -v strace > /dev/null; then
+        strace -c -f -p $FS_PID -o /tmp/bench_readdir.strace &
+        STRACE_PID=$!
+        sleep 1
+    fi
+
+    START=$(date +%s.%N)
+    COUNT=$(ls -l /tmp/bench_readdir | tail -n +2 | wc -l)
+    END=$(date +%s.%N)
+
+    if [ -n "$STRACE_PID" ]; then
+        kill -INT $STRACE_PID
+        wait $STRACE_PID 2>/dev/null
+        echo "Daemon syscalls:"
+        grep -E "read|writev|total" /tmp/bench_readdir.strace
+        STRACE_PID=
+    fi
+
+    echo "Listed: $COUNT entries"
+    echo "Time:   $(echo "$END - $START" | bc) s"
+
+    fusermount -u /tmp/bench_readdir
+    wait $FS_PID 2>/dev/null
+done
+
+rm -f bench_readdir.bin /tmp/bench_readdir.strace
+echo -e "\n=== Benchmark Complete ==="
@@ -0,0 +1,419 @@
+#include "general_fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// دستگاه بلوکی داده فایل‌ها؛ همه خواندن و نوشتن‌های داده (extent_map.c) از این‌جا رد می‌شوند:
+//   mmap (پیش‌فرض): memcpy مستقیم در نگاشت image، مثل قبل. کرنل تصمیم می‌گیرد
+//     چه صفحه‌ای بماند و خطای دیسک SIGBUS است
+//   pio (-o blockdev=pio): pread/pwrite روی فایل image از یک کش بافر با اندازه
+//     ثابت (-o cache_mb=N). جایگزینی با CLOCK، بلوک کثیف هنگام بیرون رفتن،
+//     در flush/fsync همان فایل و در unmount نوشته می‌شود و خطا -EIO برمی‌گرداند.
+//     با -o o_direct از page cache میزبان هم رد نمی‌شود
+// متادیتا (entryها، نام‌ها، bitmap، بلوک‌های extent) همچنان از mmap خوانده
+// می‌شود؛ صفحه‌های داده‌ای که هرگز لمس نمی‌شوند در RSS حساب نمی‌شوند
+// بلوکی که آزاد می‌شود قبل از برگشتن به لیست خالی از کش بیرون می‌رود تا
+// نسخه کهنه آن روی متادیتا یا فایل بعدی نوشته نشود
+
+// ==================== mmap ====================
+
+static int mmap_io(struct fs_state *state, uint64_t offset, char *out, const char *in, size_t size) {
+    char *disk = (char *)state->data + offset;
+
+    if (out) {
+        memcpy(out, disk, size);
+    } else if (in) {
+        memcpy(disk, in, size);
+    } else {
+        memset(disk, 0, size);
+    }
+    return 0;
+}
+
+static void mmap_forget(struct fs_state *state, uint32_t start_block, uint32_t block_count) {
+    (void) state;
+    (void) start_block;
+    (void) block_count;
+}
+
+static int mmap_flush(struct fs_state *state, uint32_t start_block, uint32_t block_count) {
+    (void) state;
+    (void) start_block;
+    (void) block_count;
+    return 0;
+}
+
+static const fs_bdev_ops_t mmap_ops = { "mmap", 1, mmap_io, mmap_forget, mmap_flush };
+
+// ==================== pread/pwrite با کش بافر ====================
+
+static char *frame_data(fs_cache_shard_t *shard, fs_cache_frame_t *frame) {
+    return shard->data + (size_t)(frame - shard->frames) * BLOCK_SIZE;
+}
+
+// خانه هش بلوک در تکه خودش (بلوک‌های پشت سر هم خانه‌های پشت سر هم)
+static int32_t *hash_head(fs_cache_shard_t *shard, uint32_t block) {
+    return &shard->hash[(block / FS_CACHE_SHARDS) & shard->hash_mask];
+}
+
+static fs_cache_frame_t *frame_find(fs_cache_shard_t *shard, uint32_t block) {
+    for (int32_t i = *hash_head(shard, block); i >= 0; i = shard->frames[i].next) {
+        if (shard->frames[i].block == block) {
+            return &shard->frames[i];
+        }
+    }
+    return NULL;
+}
+
+// بیرون بردن فریم از هش و خالی کردن آن (بدون نوشتن)
+static void frame_drop(fs_cache_shard_t *shard, fs_cache_frame_t *frame) {
+    int32_t index = frame - shard->frames;
+    int32_t *link = hash_head(shard, frame->block);
+    while (*link != index) {
+        link = &shard->frames[*link].next;
+    }
+    *link = frame->next;
+
+    if (frame->dirty) {
+        shard->dirty_count--;
+    }
+    frame->block = FS_HOLE;
+    frame->dirty = 0;
+    frame->referenced = 0;
+    frame->next = -1;
+}
+
+static int frame_writeback(struct fs_state *state, fs_cache_shard_t *shard, fs_cache_frame_t *frame) {
+    ssize_t n = pwrite(state->bdev.fd, frame_data(shard, frame), BLOCK_SIZE,
+                       (off_t)frame->block * BLOCK_SIZE);
+    if (n != BLOCK_SIZE) {
+        fs_log_error("Block cache: write of block %u failed: %s",
+                     frame->block, n < 0 ? strerror(errno) : "short write");
+        return -EIO;
+    }
+    frame->dirty = 0;
+    shard->dirty_count--;
+    shard->writebacks++;
+    return 0;
+}
+
+// CLOCK: عقربه بیت مراجعه را پاک می‌کند تا به فریمی برسد که از دور قبل
+// دوباره استفاده نشده؛ حداکثر دو دور
+static fs_cache_frame_t *clock_victim(fs_cache_shard_t *shard) {
+    for (;;) {
+        fs_cache_frame_t *frame = &shard->frames[shard->hand];
+        shard->hand = (shard->hand + 1) % shard->frame_count;
+        if (frame->block == FS_HOLE || !frame->referenced) {
+            return frame;
+        }
+        frame->referenced = 0;
+    }
+}
+
+// فریم بلوک (زیر قفل تکه)؛ load یعنی محتوای فعلی لازم است و در غیر این
+// صورت (نوشتن کل بلوک) از دیسک خوانده نمی‌شود
+static int frame_get(struct fs_state *state, fs_cache_shard_t *shard, uint32_t block, int load,
+                     fs_cache_frame_t **out) {
+    fs_cache_frame_t *frame = frame_find(shard, block);
+    if (frame) {
+        shard->hits++;
+        frame->referenced = 1;
+        *out = frame;
+        return 0;
+    }
+
+    shard->misses++;
+    frame = clock_victim(shard);
+    if (frame->block != FS_HOLE) {
+        if (frame->dirty) {
+            int res = frame_writeback(state, shard, frame);
+            if (res < 0) {
+                return res;
+            }
+        }
+        frame_drop(shard, frame);
+    }
+
+    if (load) {
+        ssize_t n = pread(state->bdev.fd, frame_data(shard, frame), BLOCK_SIZE, (off_t)block * BLOCK_SIZE);
+        if (n != BLOCK_SIZE) {
+            fs_log_error("Block cache: read of block %u failed: %s",
+                         block, n < 0 ? strerror(errno) : "short read");
+            return -EIO;
+        }
+    }
+
+    int32_t *head = hash_head(shard, block);
+    frame->block = block;
+    frame->referenced = 1;
+    frame->next = *head;
+    *head = frame - shard->frames;
+    *out = frame;
+    return 0;
+}
+
+static int pio_io(struct fs_state *state, uint64_t offset, char *out, const char *in, size_t size) {
+    while (size > 0) {
+        uint32_t block = offset / BLOCK_SIZE;
+        size_t skip = offset % BLOCK_SIZE;
+        size_t n = size < BLOCK_SIZE - skip ? size : BLOCK_SIZE - skip;
+        fs_cache_shard_t *shard = &state->bdev.shards[block % FS_CACHE_SHARDS];
+        fs_cache_frame_t *frame;
+
+        pthread_mutex_lock(&shard->lock);
+        int res = frame_get(state, shard, block, out || n < BLOCK_SIZE, &frame);
+        if (res == 0) {
+            char *data = frame_data(shard, frame) + skip;
+            if (out) {
+                memcpy(out, data, n);
+            } else {
+                if (in) {
+                    memcpy(data, in, n);
+                } else {
+                    memset(data, 0, n);
+                }
+                if (!frame->dirty) {
+                    frame->dirty = 1;
+                    shard->dirty_count++;
+                }
+            }
+        }
+        pthread_mutex_unlock(&shard->lock);
+        if (res < 0) {
+            return res;
+        }
+
+        if (out) {
+            out += n;
+        } else if (in) {
+            in += n;
+        }
+        offset += n;
+        size -= n;
+    }
+    return 0;
+}
+
+// اجرای visit روی فریم‌های کش [start_block, start_block + block_count) زیر قفل تکه؛
+// خطای اول برگردانده می‌شود و بقیه فریم‌ها باز هم دیده می‌شوند
+static int cache_range(struct fs_state *state, uint32_t start_block, uint32_t block_count,
+                       int (*visit)(struct fs_state *state, fs_cache_shard_t *shard,
+                                    fs_cache_frame_t *frame)) {
+    uint64_t end = (uint64_t)start_block + block_count;
+    int res = 0;
+
+    for (uint32_t s = 0; s < FS_CACHE_SHARDS; s++) {
+        fs_cache_shard_t *shard = &state->bdev.shards[s];
+        pthread_mutex_lock(&shard->lock);
+        if (block_count / FS_CACHE_SHARDS < shard->frame_count) {
+            // محدوده کوچک: فقط بلوک‌های این تکه جستجو می‌شوند
+            uint32_t first = start_block + (s + FS_CACHE_SHARDS - start_block % FS_CACHE_SHARDS) % FS_CACHE_SHARDS;
+            for (uint64_t block = first; block < end; block += FS_CACHE_SHARDS) {
+                fs_cache_frame_t *frame = frame_find(shard, block);
+                int err = frame ? visit(state, shard, frame) : 0;
+                if (err < 0 && res == 0) {
+                    res = err;
+                }
+            }
+        } else {
+            for (uint32_t i = 0; i < shard->frame_count; i++) {
+                fs_cache_frame_t *frame = &shard->frames[i];
+                if (frame->block != FS_HOLE && frame->block >= start_block && frame->block < end) {
+                    int err = visit(state, shard, frame);
+                    if (err < 0 && res == 0) {
+                        res = err;
+                    }
+                }
+            }
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    return res;
+}
+
+static int forget_visit(struct fs_state *state, fs_cache_shard_t *shard, fs_cache_frame_t *frame) {
+    (void) state;
+    frame_drop(shard, frame);
+    return 0;
+}
+
+static int flush_visit(struct fs_state *state, fs_cache_shard_t *shard, fs_cache_frame_t *frame) {
+    return frame->dirty ? frame_writeback(state, shard, frame) : 0;
+}
+
+static void pio_forget(struct fs_state *state, uint32_t start_block, uint32_t block_count) {
+    cache_range(state, start_block, block_count, forget_visit);
+}
+
+// نوشتن بلوک‌های کثیف محدوده
+static int pio_flush(struct fs_state *state, uint32_t start_block, uint32_t block_count) {
+    return cache_range(state, start_block, block_count, flush_visit);
+}
+
+static const fs_bdev_ops_t pio_ops = { "pio", 0, pio_io, pio_forget, pio_flush };
+
+static void cache_free(fs_blockdev_t *bdev) {
+    for (uint32_t s = 0; s < FS_CACHE_SHARDS; s++) {
+        fs_cache_shard_t *shard = &bdev->shards[s];
+        if (!shard->frames) continue;
+
+        pthread_mutex_destroy(&shard->lock);
+        free(shard->frames);
+        free(shard->data);
+        free(shard->hash);
+        shard->frames = NULL;
+    }
+}
+
+static int cache_init(fs_blockdev_t *bdev) {
+    uint32_t cache_mb = bdev->cache_mb ? bdev->cache_mb : FS_CACHE_DEFAULT_MB;
+    uint64_t total = (uint64_t)cache_mb * 1024 * 1024 / BLOCK_SIZE;
+    if (total > FS_TOTAL_BLOCKS) {
+        total = FS_TOTAL_BLOCKS;
+    }
+    uint32_t frame_count = (total + FS_CACHE_SHARDS - 1) / FS_CACHE_SHARDS;
+
+    uint32_t hash_size = 1;
+    while (hash_size < frame_count * 2) {
+        hash_size <<= 1;
+    }
+
+    for (uint32_t s = 0; s < FS_CACHE_SHARDS; s++) {
+        fs_cache_shard_t *shard = &bdev->shards[s];
+        memset(shard, 0, sizeof(*shard));
+        shard->frames = calloc(frame_count, sizeof(fs_cache_frame_t));
+        shard->hash = malloc(hash_size * sizeof(int32_t));
+        if (!shard->frames || !shard->hash ||
+            posix_memalign((void **)&shard->data, BLOCK_SIZE, (size_t)frame_count * BLOCK_SIZE) != 0) {
+            free(shard->frames);
+            free(shard->hash);
+            shard->frames = NULL;
+            cache_free(bdev);
+            return -ENOMEM;
+        }
+
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->frame_count = frame_count;
+        shard->hash_mask = hash_size - 1;
+        memset(shard->hash, 0xff, hash_size * sizeof(int32_t));
+        for (uint32_t i = 0; i < frame_count; i++) {
+            shard->frames[i].next = -1;
+        }
+    }
+
+    fs_log_info("Block cache: %u MB in %u frames", cache_mb, frame_count * FS_CACHE_SHARDS);
+    return 0;
+}
+
+// ==================== رابط ====================
+
+static const fs_bdev_ops_t *bdev_ops(struct fs_state *state) {
+    return state->bdev.ops ? state->bdev.ops : &mmap_ops;
+}
+
+// انتخاب backend بعد از باز شدن image؛ O_DIRECT اگر میزبان پشتیبانی نکند
+// با هشدار به ورودی/خروجی معمولی برمی‌گردد
+int fs_bdev_open(struct fs_state *state, const char *disk_file) {
+    fs_blockdev_t *bdev = &state->bdev;
+    bdev->fd = state->fd;
+
+    if (bdev->backend != FS_BDEV_PIO) {
+        bdev->ops = &mmap_ops;
+        return 0;
+    }
+
+    if (cache_init(bdev) < 0) {
+        fprintf(stderr, "Failed to allocate block cache\n");
+        return -ENOMEM;
+    }
+
+    if (bdev->direct) {
+        int fd = open(disk_file, O_RDWR | O_DIRECT);
+        if (fd == -1) {
+            fs_log_warn("O_DIRECT not supported for %s (%s), using buffered I/O",
+                        disk_file, strerror(errno));
+        } else {
+            bdev->fd = fd;
+        }
+    }
+
+    bdev->ops = &pio_ops;
+    fs_log_info("Block device: pio%s", bdev->fd != state->fd ? " (O_DIRECT)" : "");
+    return 0;
+}
+
+// نوشتن بلوک‌های کثیف و آزاد کردن کش (قبل از munmap)
+void fs_bdev_close(struct fs_state *state) {
+    fs_blockdev_t *bdev = &state->bdev;
+    if (bdev->ops != &pio_ops) {
+        bdev->ops = NULL;
+        return;
+    }
+
+    pio_flush(state, 0, UINT32_MAX);
+
+    uint64_t hits = 0, misses = 0, writebacks = 0;
+    for (uint32_t s = 0; s < FS_CACHE_SHARDS; s++) {
+        hits += bdev->shards[s].hits;
+        misses += bdev->shards[s].misses;
+        writebacks += bdev->shards[s].writebacks;
+    }
+    fs_log_info("Block cache: %llu hits, %llu misses, %llu writebacks",
+                (unsigned long long)hits, (unsigned long long)misses,
+                (unsigned long long)writebacks);
+
+    cache_free(bdev);
+    if (bdev->fd != state->fd) {
+        close(bdev->fd);
+    }
+    bdev->fd = state->fd;
+    bdev->ops = NULL;
+}
+
+int fs_bdev_io(struct fs_state *state, uint64_t offset, char *out, const char *in, size_t size) {
+    return bdev_ops(state)->io(state, offset, out, in, size);
+}
+
+// کپی بلوک‌ها (جابجایی defrag)؛ محدوده‌ها روی هم نمی‌افتند
+int fs_bdev_copy(struct fs_state *state, uint32_t dst_block, uint32_t src_block, uint32_t block_count) {
+    if (bdev_ops(state) == &mmap_ops) {
+        return mmap_io(state, (uint64_t)dst_block * BLOCK_SIZE,
+                       NULL, (char *)state->data + (size_t)src_block * BLOCK_SIZE,
+                       (size_t)block_count * BLOCK_SIZE);
+    }
+
+    char *buf = malloc(BLOCK_SIZE);
+    if (!buf) {
+        return -ENOMEM;
+    }
+
+    int res = 0;
+    for (uint32_t i = 0; i < block_count && res == 0; i++) {
+        res = pio_io(state, (uint64_t)(src_block + i) * BLOCK_SIZE, buf, NULL, BLOCK_SIZE);
+        if (res == 0) {
+            res = pio_io(state, (uint64_t)(dst_block + i) * BLOCK_SIZE, NULL, buf, BLOCK_SIZE);
+        }
+    }
+    free(buf);
+    return res;
+}
+
+// بیرون بردن بلوک‌های آزاد شده از کش بدون نوشتن (قبل از برگشتن به لیست خالی)
+void fs_bdev_forget(struct fs_state *state, uint32_t start_block, uint32_t block_count) {
+    bdev_ops(state)->forget(state, start_block, block_count);
+}
+
+// نوشتن بلوک‌های کثیف یک محدوده روی فایل image (flush و fsync فایل)
+int fs_bdev_flush(struct fs_state *state, uint32_t start_block, uint32_t block_count) {
+    return bdev_ops(state)->flush(state, start_block, block_count);
+}
+
+// fsync: داده image (نوشته شده از کش یا صفحه‌های کثیف mmap) روی دیسک میزبان
+int fs_bdev_sync(struct fs_state *state, int datasync) {
+    int res = datasync ? fdatasync(state->bdev.fd) : fsync(state->bdev.fd);
+    return res < 0 ? -errno : 0;
+}
+
+// آیا بافرهای fd روی فایل image (splice) همان داده کش را می‌بینند
+int fs_bdev_splice(struct fs_state *state) {
+    return bdev_ops(state)->splice;
+}
@@ -17,6 +17,7 @@ void print_usage() {
     printf("  read <file>             - Read file content\n");
     printf("  viz                     - Visualize free space\n");
     printf("  info                    - Show filesystem info\n");
+    printf("  defrag                  - Defragment files and coalesce free space\n");
 }
 
 int main(int argc, char *argv[]) {
@@ -45,31 +46,31 @@ int main(int argc, char *argv[]) {
     // اجرای دستورات
     if (strcmp(command, "list") == 0) {
         printf("Files in filesystem:\n");
-        for (uint32_t i = 0; i < state.superblock->file_count; i++) {
+        for (uint32_t i = 0; i < state.superblock->slot_count; i++) {
+            if (fs_entry(&state, i)->type == FS_TYPE_FREE) continue;
             printf("  %s [%s]\n", 
-                   state.file_table[i].name,
-                   state.file_table[i].type == 1 ? "DIR" : "FILE");
+                   fs_entry_name(&state, i),
+                   fs_entry(&state, i)->type == 1 ? "DIR" : "FILE");
         }
         
     } else if (strcmp(command, "viz") == 0) {
         fs_visualize_free_space(&state);
         
+    } else if (strcmp(command, "defrag") == 0) {
+        fs_defrag(&state);
+        
     } else if (strcmp(command, "info") == 0) {
         printf("Filesystem Information:\n");
         printf("  Magic number: 0x%08X\n", state.superblock->magic);
         printf("  Version: %u\n", state.superblock->version);
         printf("  File count: %u\n", state.superblock->file_count);
         printf("  Last used byte: %u\n", state.superblock->last_used_byte);
-        printf("  Free blocks in list: %u\n", state.superblock->free_block_count);
+        printf("  Block bitmap at block: %u\n", state.superblock->bitmap_offset / BLOCK_SIZE);
+        printf("  Free extents: %u\n", state.superblock->free_block_count);
         
         // محاسبه فضای کل و آزاد
         uint32_t total_blocks = FS_SIZE / BLOCK_SIZE;
-        uint32_t free_blocks = 0;
-        free_block_t *current = state.free_list;
-        while (current) {
-            free_blocks += current->block_count;
-            current = current->next;
-        }
+        uint32_t free_blocks = fs_free_total(&state);
         
         printf("  Total blocks: %u\n", total_blocks);
         printf("  Used blocks: %u\n", total_blocks - free_blocks);
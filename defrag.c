@@ -0,0 +1,224 @@
+#include "general_fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// defrag در دو مرحله:
+// 1. هر فایل تکه‌تکه به یک محدوده پیوسته (best-fit) منتقل می‌شود
+// 2. فشرده‌سازی: فایل‌ها به ترتیب مکان به پایین‌ترین extent خالی که جا دارند
+//    منتقل می‌شوند تا فضای خالی در انتهای دیسک یکجا شود
+// autodefrag همان مرحله اول را برای فایل‌های کوچک هنگام release انجام می‌دهد
+
+static int stats_visit(const free_block_t *node, void *arg) {
+    fs_frag_stats_t *stats = arg;
+    stats->free_extents++;
+    stats->free_blocks += node->block_count;
+    if (node->block_count > stats->largest_free) {
+        stats->largest_free = node->block_count;
+    }
+    return 0;
+}
+
+void fs_frag_stats(struct fs_state *state, fs_frag_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    for (uint32_t slot = 0; slot < state->superblock->slot_count; slot++) {
+        file_entry_t *entry = fs_entry(state, slot);
+        if (entry->type == FS_TYPE_FREE || entry->alloc_blocks == 0) continue;
+
+        uint32_t fragments = fs_extent_fragments(state, entry, NULL);
+        stats->files++;
+        stats->fragments += fragments;
+        if (fragments > 1) {
+            stats->fragmented++;
+        }
+    }
+
+    fs_free_walk(state, stats_visit, stats);
+}
+
+void fs_frag_print(const char *label, const fs_frag_stats_t *stats) {
+    printf("%s: %u files, %u fragmented, %.2f fragments/file; "
+           "%u free blocks in %u extents (largest %u)\n",
+           label, stats->files, stats->fragmented,
+           stats->files ? (double)stats->fragments / stats->files : 0.0,
+           stats->free_blocks, stats->free_extents, stats->largest_free);
+}
+
+// انتقال داده entry به محدوده تخصیص یافته؛ در صورت خطا محدوده آزاد می‌شود
+static int relocate(struct fs_state *state, file_entry_t *entry, uint32_t start_block) {
+    uint32_t blocks = entry->alloc_blocks;
+    int res = fs_extent_relocate(state, entry, start_block);
+    if (res < 0) {
+        fs_free_blocks(start_block, blocks, state);
+        return res;
+    }
+    return blocks;
+}
+
+// یکپارچه کردن یک فایل؛ تعداد بلوک‌های جابجا شده (صفر اگر لازم نبود یا جا نبود)
+int fs_defrag_file(struct fs_state *state, uint32_t slot) {
+    file_entry_t *entry = fs_entry(state, slot);
+    if (entry->type == FS_TYPE_FREE || entry->alloc_blocks == 0 ||
+        fs_extent_fragments(state, entry, NULL) <= 1) {
+        return 0;
+    }
+
+    // بدون محدوده پیوسته به این اندازه فایل همان‌طور می‌ماند
+    if (fs_largest_free(state) < entry->alloc_blocks) {
+        return 0;
+    }
+
+    uint32_t start_block;
+    if (fs_alloc_blocks(entry->alloc_blocks, state, &start_block) < 0) {
+        return 0;
+    }
+    return relocate(state, entry, start_block);
+}
+
+typedef struct {
+    uint32_t first_block;
+    uint32_t blocks;
+    uint32_t start_block;
+} compact_target_t;
+
+static int compact_visit(const free_block_t *node, void *arg) {
+    compact_target_t *target = arg;
+    if (node->start_block >= target->first_block) {
+        return 1;
+    }
+    if (node->block_count >= target->blocks) {
+        target->start_block = node->start_block;
+        return 1;
+    }
+    return 0;
+}
+
+// انتقال فایل پیوسته به پایین‌ترین extent خالی قبل از آن که جایش می‌شود
+static int compact_file(struct fs_state *state, uint32_t slot, uint32_t first_block) {
+    file_entry_t *entry = fs_entry(state, slot);
+    uint32_t blocks = entry->alloc_blocks;
+
+    compact_target_t target = { first_block, blocks, FS_HOLE };
+    fs_free_walk(state, compact_visit, &target);
+    uint32_t start_block = target.start_block;
+
+    if (start_block == FS_HOLE) {
+        return 0;
+    }
+
+    // ممکن است بین پیمایش و تخصیص بخشی از extent تخصیص یافته باشد
+    uint32_t got = fs_alloc_blocks_at(start_block, blocks, state);
+    if (got != blocks) {
+        if (got > 0) {
+            fs_free_blocks(start_block, got, state);
+        }
+        return 0;
+    }
+    return relocate(state, entry, start_block);
+}
+
+typedef struct {
+    uint32_t first_block;
+    uint32_t slot;
+} defrag_item_t;
+
+static int item_compare(const void *a, const void *b) {
+    const defrag_item_t *x = a, *y = b;
+    return x->first_block < y->first_block ? -1 : x->first_block > y->first_block;
+}
+
+// defrag کامل (از cli روی image جدا شده)؛ تعداد بلوک‌های جابجا شده
+int fs_defrag(struct fs_state *state) {
+    fs_frag_stats_t stats;
+    fs_frag_stats(state, &stats);
+    fs_frag_print("Before defrag", &stats);
+
+    uint32_t moved_files = 0;
+    uint64_t moved_blocks = 0;
+    uint32_t slot_count = state->superblock->slot_count;
+
+    for (uint32_t slot = 0; slot < slot_count; slot++) {
+        int moved = fs_defrag_file(state, slot);
+        if (moved > 0) {
+            moved_files++;
+            moved_blocks += moved;
+        }
+    }
+
+    defrag_item_t *items = malloc((size_t)slot_count * sizeof(defrag_item_t));
+    if (!items) {
+        return -ENOMEM;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t slot = 0; slot < slot_count; slot++) {
+        file_entry_t *entry = fs_entry(state, slot);
+        if (entry->type == FS_TYPE_FREE || entry->alloc_blocks == 0) continue;
+
+        // فایل‌هایی که تکه‌تکه ماندند (جای پیوسته نبود) جابجا نمی‌شوند
+        uint32_t first_block;
+        if (fs_extent_fragments(state, entry, &first_block) != 1) continue;
+        items[count].first_block = first_block;
+        items[count].slot = slot;
+        count++;
+    }
+    qsort(items, count, sizeof(defrag_item_t), item_compare);
+
+    for (uint32_t i = 0; i < count; i++) {
+        int moved = compact_file(state, items[i].slot, items[i].first_block);
+        if (moved > 0) {
+            moved_files++;
+            moved_blocks += moved;
+        }
+    }
+    free(items);
+
+    printf("Defrag: moved %u files (%llu blocks)\n", moved_files, (unsigned long long)moved_blocks);
+    fs_frag_stats(state, &stats);
+    fs_frag_print("After defrag", &stats);
+    return moved_blocks > INT32_MAX ? INT32_MAX : (int)moved_blocks;
+}
+
+// autodefrag هنگام release: فقط فایل‌های تا FS_DEFRAG_MAX_BLOCKS و با بودجه
+// FS_DEFRAG_RATE بلوک در ثانیه، تا تأخیر درخواست‌های دیگر محدود بماند
+void fs_autodefrag(struct fs_state *state, uint32_t slot) {
+    fs_defrag_config_t *defrag = &state->defrag;
+    file_entry_t *entry = fs_entry(state, slot);
+
+    if (!defrag->autodefrag || entry->type == FS_TYPE_FREE ||
+        entry->alloc_blocks == 0 || entry->alloc_blocks > FS_DEFRAG_MAX_BLOCKS) {
+        return;
+    }
+    if (fs_extent_fragments(state, entry, NULL) <= 1) {
+        return;
+    }
+
+    // بودجه بین همه فایل‌ها مشترک است؛ قبل از جابجایی برداشته می‌شود
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint32_t blocks = entry->alloc_blocks;
+    int allowed = 0;
+
+    pthread_mutex_lock(&defrag->lock);
+    double elapsed = (now.tv_sec - defrag->last.tv_sec) + (now.tv_nsec - defrag->last.tv_nsec) / 1e9;
+    defrag->last = now;
+    defrag->tokens += elapsed * FS_DEFRAG_RATE;
+    if (defrag->tokens > FS_DEFRAG_MAX_BLOCKS) {
+        defrag->tokens = FS_DEFRAG_MAX_BLOCKS;
+    }
+    if (defrag->tokens >= blocks) {
+        defrag->tokens -= blocks;
+        allowed = 1;
+    }
+    pthread_mutex_unlock(&defrag->lock);
+
+    if (!allowed) {
+        return;
+    }
+
+    int moved = fs_defrag_file(state, slot);
+    if (moved > 0) {
+        fs_log_info("Autodefrag: moved %d blocks of %s", moved, fs_entry_name(state, slot));
+    }
+}
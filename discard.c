@@ -0,0 +1,215 @@
+#include "general_fs.h"
+#include <stdio.h>
+#include <linux/falloc.h>
+
+// بلوک‌های آزاد شده در فایل image روی میزبان تخصیص یافته باقی می‌مانند؛
+// بازه‌های خالی بزرگ در یک worker پس‌زمینه با FALLOC_FL_PUNCH_HOLE پانچ می‌شوند.
+// صف فقط با mutex خودش محافظت می‌شود و worker هرگز به لیست بلوک‌های خالی دست نمی‌زند:
+// تخصیص هر بلوک آن را از صف حذف می‌کند و چون worker قفل را هنگام پانچ نگه می‌دارد،
+// پانچ هیچ‌وقت بعد از تخصیص (و نوشتن داده جدید) روی همان بلوک رخ نمی‌دهد.
+
+// پانچ یک بازه؛ صفحه‌های میزبان آزاد می‌شوند و خواندن بعدی صفر برمی‌گرداند
+static int discard_punch(struct fs_state *state, uint32_t start_block, uint32_t block_count) {
+    fs_discard_t *d = &state->discard;
+    if (d->disabled) {
+        return -EOPNOTSUPP;
+    }
+
+    if (fallocate(state->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  (off_t)start_block * BLOCK_SIZE, (off_t)block_count * BLOCK_SIZE) < 0) {
+        int err = errno;
+        if (err == EOPNOTSUPP || err == ENOSYS) {
+            // یک بار گزارش می‌شود و بعد از آن دیگر تلاشی نمی‌شود
+            d->disabled = 1;
+            fs_log_warn("Host filesystem cannot punch holes, discard disabled");
+        } else {
+            fs_log_error("punching blocks %u-%u failed: %s",
+                         start_block, start_block + block_count - 1, strerror(err));
+        }
+        return -err;
+    }
+
+    d->punched_blocks += block_count;
+    d->punch_calls++;
+    return 0;
+}
+
+// پانچ همه بازه‌های صف (قفل در دست فراخواننده است)
+static void discard_flush(struct fs_state *state) {
+    fs_discard_t *d = &state->discard;
+    uint32_t blocks = 0;
+
+    for (uint32_t i = 0; i < d->count; i++) {
+        if (discard_punch(state, d->pending[i].start_block, d->pending[i].block_count) == 0) {
+            blocks += d->pending[i].block_count;
+        }
+    }
+
+    if (d->count > 0 && blocks > 0) {
+        fs_log_debug("Discarded %u blocks in %u ranges", blocks, d->count);
+    }
+    d->count = 0;
+}
+
+static void *discard_worker(void *arg) {
+    struct fs_state *state = arg;
+    fs_discard_t *d = &state->discard;
+
+    pthread_mutex_lock(&d->lock);
+    while (!d->stop) {
+        if (d->count < FS_DISCARD_BATCH) {
+            // یا صف به اندازه یک دسته برسد یا مهلت تمام شود
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += FS_DISCARD_INTERVAL;
+            pthread_cond_timedwait(&d->wake, &d->lock, &deadline);
+        }
+        discard_flush(state);
+    }
+    discard_flush(state);
+    pthread_mutex_unlock(&d->lock);
+    return NULL;
+}
+
+// شروع worker؛ باید در پروسه نهایی (بعد از daemonize) صدا زده شود
+int fs_discard_start(struct fs_state *state) {
+    fs_discard_t *d = &state->discard;
+    if (d->running) {
+        return 0;
+    }
+
+    pthread_mutex_init(&d->lock, NULL);
+    pthread_cond_init(&d->wake, NULL);
+    d->stop = 0;
+    d->count = 0;
+
+    int err = pthread_create(&d->thread, NULL, discard_worker, state);
+    if (err != 0) {
+        fs_log_error("cannot start discard worker: %s", strerror(err));
+        pthread_cond_destroy(&d->wake);
+        pthread_mutex_destroy(&d->lock);
+        return -err;
+    }
+
+    d->running = 1;
+    return 0;
+}
+
+// توقف worker بعد از پانچ بازه‌های باقی‌مانده در صف
+void fs_discard_stop(struct fs_state *state) {
+    fs_discard_t *d = &state->discard;
+    if (!d->running) {
+        return;
+    }
+
+    pthread_mutex_lock(&d->lock);
+    d->stop = 1;
+    pthread_cond_signal(&d->wake);
+    pthread_mutex_unlock(&d->lock);
+
+    pthread_join(d->thread, NULL);
+    d->running = 0;
+    pthread_cond_destroy(&d->wake);
+    pthread_mutex_destroy(&d->lock);
+}
+
+// اضافه کردن یک بازه خالی به صف (بعد از آزادسازی، با اندازه بعد از ادغام)
+void fs_discard_queue(struct fs_state *state, uint32_t start_block, uint32_t block_count) {
+    fs_discard_t *d = &state->discard;
+    if (!d->running || d->disabled || block_count < FS_DISCARD_MIN) {
+        return;
+    }
+
+    uint32_t start = start_block;
+    uint32_t end = start_block + block_count;
+
+    pthread_mutex_lock(&d->lock);
+
+    // بازه‌های هم‌پوشان یا مجاور در صف جذب بازه جدید می‌شوند
+    for (uint32_t i = 0; i < d->count; ) {
+        fs_extent_t *p = &d->pending[i];
+        uint32_t p_end = p->start_block + p->block_count;
+        if (p->start_block > end || p_end < start) {
+            i++;
+            continue;
+        }
+        if (p->start_block < start) start = p->start_block;
+        if (p_end > end) end = p_end;
+        *p = d->pending[--d->count];
+    }
+
+    // اگر صف پر باشد بازه رها می‌شود؛ fs_discard_sweep هنگام بستن دیسک آن را پس می‌گیرد
+    if (d->count < FS_DISCARD_QUEUE) {
+        d->pending[d->count].start_block = start;
+        d->pending[d->count].block_count = end - start;
+        d->count++;
+        if (d->count >= FS_DISCARD_BATCH) {
+            pthread_cond_signal(&d->wake);
+        }
+    }
+
+    pthread_mutex_unlock(&d->lock);
+}
+
+// حذف بلوک‌هایی که دوباره تخصیص یافته‌اند از صف
+void fs_discard_cancel(struct fs_state *state, uint32_t start_block, uint32_t block_count) {
+    fs_discard_t *d = &state->discard;
+    if (!d->running) {
+        return;
+    }
+
+    uint32_t end = start_block + block_count;
+
+    pthread_mutex_lock(&d->lock);
+
+    for (uint32_t i = 0; i < d->count; ) {
+        fs_extent_t p = d->pending[i];
+        uint32_t p_end = p.start_block + p.block_count;
+        if (p_end <= start_block || p.start_block >= end) {
+            i++;
+            continue;
+        }
+
+        d->pending[i] = d->pending[--d->count];
+
+        // تکه‌های قبل و بعد از محدوده تخصیص یافته اگر هنوز بزرگ باشند در صف می‌مانند
+        if (start_block > p.start_block && start_block - p.start_block >= FS_DISCARD_MIN &&
+            d->count < FS_DISCARD_QUEUE) {
+            d->pending[d->count].start_block = p.start_block;
+            d->pending[d->count].block_count = start_block - p.start_block;
+            d->count++;
+        }
+        if (p_end > end && p_end - end >= FS_DISCARD_MIN && d->count < FS_DISCARD_QUEUE) {
+            d->pending[d->count].start_block = end;
+            d->pending[d->count].block_count = p_end - end;
+            d->count++;
+        }
+    }
+
+    pthread_mutex_unlock(&d->lock);
+}
+
+static int sweep_visit(const free_block_t *node, void *arg) {
+    struct fs_state *state = arg;
+    if (state->discard.disabled) {
+        return 1;
+    }
+    if (node->block_count >= FS_DISCARD_MIN) {
+        discard_punch(state, node->start_block, node->block_count);
+    }
+    return 0;
+}
+
+// پانچ همه بازه‌های خالی بزرگ؛ فقط وقتی worker متوقف است (هنگام بستن دیسک)
+// فضای بازه‌های رها شده از صف پر و imageهای قدیمی‌تر را هم پس می‌گیرد
+void fs_discard_sweep(struct fs_state *state) {
+    if (state->discard.running || state->fd == -1) {
+        return;
+    }
+
+    uint64_t before = state->discard.punched_blocks;
+    fs_free_walk(state, sweep_visit, state);
+
+    fs_log_info("Discard sweep: punched %llu free blocks",
+                (unsigned long long)(state->discard.punched_blocks - before));
+}
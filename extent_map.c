@@ -0,0 +1,655 @@
+#include "general_fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// extent اول فایل در خود entry است (data_offset و inline_blocks)
+// و بقیه به ترتیب در زنجیره بلوک‌های extent؛ بزرگ شدن فایل فقط بلوک‌های
+// جدید را تخصیص می‌دهد و داده قبلی هرگز کپی نمی‌شود
+// extent با start_block برابر FS_HOLE حفره است: بلوکی ندارد و صفر خوانده می‌شود
+
+static extent_block_t *extent_block(struct fs_state *state, uint32_t block) {
+    return (extent_block_t *)((char *)state->data + (size_t)block * BLOCK_SIZE);
+}
+
+// extent شماره index (از 1) در زنجیره بلوک‌های extent
+static fs_extent_t *spill_extent(struct fs_state *state, file_entry_t *entry, uint32_t index) {
+    uint32_t pos = index - 1;
+    extent_block_t *block = extent_block(state, entry->extent_block);
+
+    while (pos >= FS_EXTENTS_PER_BLOCK) {
+        block = extent_block(state, block->next_block);
+        pos -= FS_EXTENTS_PER_BLOCK;
+    }
+    return &block->extents[pos];
+}
+
+static fs_extent_t get_extent(struct fs_state *state, file_entry_t *entry, uint32_t index) {
+    if (index == 0) {
+        fs_extent_t extent = { entry->data_offset / BLOCK_SIZE, entry->inline_blocks };
+        return extent;
+    }
+    return *spill_extent(state, entry, index);
+}
+
+static void set_extent(struct fs_state *state, file_entry_t *entry, uint32_t index, fs_extent_t extent) {
+    if (index == 0) {
+        entry->data_offset = extent.start_block * BLOCK_SIZE;
+        entry->inline_blocks = extent.block_count;
+    } else {
+        *spill_extent(state, entry, index) = extent;
+    }
+}
+
+static void set_extent_blocks(struct fs_state *state, file_entry_t *entry, uint32_t index, uint32_t block_count) {
+    if (index == 0) {
+        entry->inline_blocks = block_count;
+    } else {
+        spill_extent(state, entry, index)->block_count = block_count;
+    }
+}
+
+// آیا extent دوم بلافاصله بعد از اولی می‌آید (هر دو حفره یا هر دو پشت سر هم روی دیسک)
+static int extent_adjacent(fs_extent_t first, uint32_t start_block) {
+    if (first.start_block == FS_HOLE || start_block == FS_HOLE) {
+        return first.start_block == start_block;
+    }
+    return first.start_block + first.block_count == start_block;
+}
+
+// اضافه کردن بلوک extent به انتهای زنجیره
+static int chain_append(struct fs_state *state, file_entry_t *entry) {
+    uint32_t block;
+    if (fs_alloc_blocks(1, state, &block) < 0) {
+        return -ENOSPC;
+    }
+    memset(extent_block(state, block), 0, BLOCK_SIZE);
+
+    uint32_t *link = &entry->extent_block;
+    while (*link) {
+        link = &extent_block(state, *link)->next_block;
+    }
+    *link = block;
+    return 0;
+}
+
+// آزادسازی بلوک‌های extent بعد از needed بلوک اول زنجیره
+static void chain_trim(struct fs_state *state, file_entry_t *entry, uint32_t needed) {
+    uint32_t *link = &entry->extent_block;
+    for (uint32_t n = 0; *link; n++) {
+        extent_block_t *block = extent_block(state, *link);
+        if (n < needed) {
+            link = &block->next_block;
+            continue;
+        }
+        uint32_t unused = *link;
+        *link = block->next_block;
+        fs_free_blocks(unused, 1, state);
+    }
+}
+
+// تعداد بلوک‌های extent لازم برای count extent
+static uint32_t chain_needed(uint32_t count) {
+    return count > 1 ? (count - 2) / FS_EXTENTS_PER_BLOCK + 1 : 0;
+}
+
+// اضافه کردن extent به انتهای فایل (یا ادغام با extent آخر اگر پشت سر هم باشند)
+static int extent_append(struct fs_state *state, file_entry_t *entry,
+                         uint32_t start_block, uint32_t block_count) {
+    uint32_t count = entry->extent_count;
+
+    if (count == 0) {
+        entry->data_offset = start_block * BLOCK_SIZE;
+        entry->inline_blocks = block_count;
+        entry->extent_count = 1;
+        return 0;
+    }
+
+    fs_extent_t last = get_extent(state, entry, count - 1);
+    if (extent_adjacent(last, start_block)) {
+        set_extent_blocks(state, entry, count - 1, last.block_count + block_count);
+        return 0;
+    }
+
+    // بلوک extent قبلی پر است (یا هنوز بلوکی نیست)
+    if ((count - 1) % FS_EXTENTS_PER_BLOCK == 0 && chain_append(state, entry) < 0) {
+        return -ENOSPC;
+    }
+
+    fs_extent_t *extent = spill_extent(state, entry, count);
+    extent->start_block = start_block;
+    extent->block_count = block_count;
+    entry->extent_count++;
+    return 0;
+}
+
+// اضافه کردن block_count بلوک به انتهای فایل
+// اول extent آخر در جا ادامه داده می‌شود، بعد best-fit و اگر محدوده پیوسته‌ای
+// به این اندازه نبود بزرگ‌ترین extentهای خالی. تخصیص‌ها در گروه انتهای داده
+// فعلی فایل (یا برای فایل خالی گروه نخ) انجام می‌شوند تا فایل‌هایی که هم‌زمان
+// نوشته می‌شوند در هم تنیده نشوند
+int fs_extent_grow(struct fs_state *state, file_entry_t *entry, uint32_t block_count) {
+    uint32_t old_blocks = entry->data_blocks;
+    uint32_t remaining = block_count;
+    uint32_t goal = FS_HOLE;
+
+    if (entry->extent_count > 0) {
+        fs_extent_t last = get_extent(state, entry, entry->extent_count - 1);
+        if (last.start_block != FS_HOLE) {
+            goal = last.start_block + last.block_count;
+            uint32_t got = fs_alloc_blocks_at(goal, remaining, state);
+            if (got > 0) {
+                set_extent_blocks(state, entry, entry->extent_count - 1, last.block_count + got);
+                entry->data_blocks += got;
+                entry->alloc_blocks += got;
+                remaining -= got;
+            }
+        }
+    }
+
+    while (remaining > 0) {
+        uint32_t start_block;
+        uint32_t want = fs_alloc_blocks_upto(goal, remaining, state, &start_block);
+        if (want == 0) {
+            fs_extent_truncate(state, entry, old_blocks);
+            return -ENOSPC;
+        }
+        if (extent_append(state, entry, start_block, want) < 0) {
+            fs_free_blocks(start_block, want, state);
+            fs_extent_truncate(state, entry, old_blocks);
+            return -ENOSPC;
+        }
+        goal = start_block + want;
+        entry->data_blocks += want;
+        entry->alloc_blocks += want;
+        remaining -= want;
+    }
+
+    return 0;
+}
+
+// اضافه کردن حفره به انتهای فایل (بدون تخصیص بلوک)
+int fs_extent_grow_hole(struct fs_state *state, file_entry_t *entry, uint32_t block_count) {
+    if (block_count == 0) return 0;
+
+    int res = extent_append(state, entry, FS_HOLE, block_count);
+    if (res < 0) {
+        return res;
+    }
+    entry->data_blocks += block_count;
+    return 0;
+}
+
+// کوتاه کردن فایل به block_count بلوک و آزادسازی بقیه (و بلوک‌های extent بی‌استفاده)
+void fs_extent_truncate(struct fs_state *state, file_entry_t *entry, uint32_t block_count) {
+    if (block_count >= entry->data_blocks) return;
+
+    uint32_t pos = 0;
+    uint32_t keep = 0;
+    for (uint32_t i = 0; i < entry->extent_count; i++) {
+        fs_extent_t extent = get_extent(state, entry, i);
+        int hole = extent.start_block == FS_HOLE;
+
+        if (pos >= block_count) {
+            if (!hole) {
+                fs_free_blocks(extent.start_block, extent.block_count, state);
+                entry->alloc_blocks -= extent.block_count;
+            }
+        } else if (pos + extent.block_count > block_count) {
+            uint32_t kept = block_count - pos;
+            if (!hole) {
+                fs_free_blocks(extent.start_block + kept, extent.block_count - kept, state);
+                entry->alloc_blocks -= extent.block_count - kept;
+            }
+            set_extent_blocks(state, entry, i, kept);
+            keep = i + 1;
+        } else {
+            keep = i + 1;
+        }
+        pos += extent.block_count;
+    }
+
+    // بلوک‌های extent که دیگر extentی ندارند
+    chain_trim(state, entry, chain_needed(keep));
+
+    if (keep == 0) {
+        entry->data_offset = 0;
+        entry->inline_blocks = 0;
+    }
+    entry->extent_count = keep;
+    entry->data_blocks = block_count;
+}
+
+// ==================== بازنویسی نقشه (حفره در وسط فایل) ====================
+// سوراخ کردن یا پر کردن حفره تعداد extentها را در وسط نقشه تغییر می‌دهد؛
+// نقشه در یک آرایه ساخته و بعد یکجا در entry و زنجیره نوشته می‌شود
+
+typedef struct {
+    fs_extent_t *items;
+    uint32_t count;
+    uint32_t capacity;
+} extent_list_t;
+
+// اضافه کردن به انتهای لیست با ادغام extentهای پشت سر هم
+static int list_push(extent_list_t *list, uint32_t start_block, uint32_t block_count) {
+    if (block_count == 0) return 0;
+
+    if (list->count > 0 && extent_adjacent(list->items[list->count - 1], start_block)) {
+        list->items[list->count - 1].block_count += block_count;
+        return 0;
+    }
+
+    if (list->count == list->capacity) {
+        uint32_t capacity = list->capacity ? list->capacity * 2 : 16;
+        fs_extent_t *items = realloc(list->items, capacity * sizeof(fs_extent_t));
+        if (!items) {
+            return -ENOMEM;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+
+    list->items[list->count].start_block = start_block;
+    list->items[list->count].block_count = block_count;
+    list->count++;
+    return 0;
+}
+
+static int list_load(struct fs_state *state, file_entry_t *entry, extent_list_t *list) {
+    memset(list, 0, sizeof(*list));
+    for (uint32_t i = 0; i < entry->extent_count; i++) {
+        fs_extent_t extent = get_extent(state, entry, i);
+        if (list_push(list, extent.start_block, extent.block_count) < 0) {
+            free(list->items);
+            return -ENOMEM;
+        }
+    }
+    return 0;
+}
+
+// نوشتن لیست به جای نقشه فعلی؛ بلوک‌های extent لازم اول گرفته می‌شوند تا
+// در صورت کمبود جا نقشه قبلی دست نخورده بماند
+static int list_store(struct fs_state *state, file_entry_t *entry, extent_list_t *list) {
+    uint32_t needed = chain_needed(list->count);
+    uint32_t have = 0;
+    for (uint32_t block = entry->extent_block; block; block = extent_block(state, block)->next_block) {
+        have++;
+    }
+
+    for (uint32_t added = 0; have + added < needed; added++) {
+        if (chain_append(state, entry) < 0) {
+            chain_trim(state, entry, have);
+            return -ENOSPC;
+        }
+    }
+
+    for (uint32_t i = 0; i < list->count; i++) {
+        set_extent(state, entry, i, list->items[i]);
+    }
+    if (list->count == 0) {
+        entry->data_offset = 0;
+        entry->inline_blocks = 0;
+    }
+    entry->extent_count = list->count;
+    chain_trim(state, entry, needed);
+    return 0;
+}
+
+// تبدیل بلوک‌های [first_block, first_block + block_count) به حفره و آزادسازی آن‌ها
+int fs_extent_punch(struct fs_state *state, file_entry_t *entry, uint32_t first_block, uint32_t block_count) {
+    if (first_block >= entry->data_blocks) return 0;
+    if (block_count > entry->data_blocks - first_block) {
+        block_count = entry->data_blocks - first_block;
+    }
+    uint32_t end_block = first_block + block_count;
+
+    extent_list_t old, list = { 0 };
+    if (list_load(state, entry, &old) < 0) {
+        return -ENOMEM;
+    }
+
+    int res = 0;
+    uint32_t pos = 0;
+    for (uint32_t i = 0; i < old.count && res == 0; i++) {
+        fs_extent_t extent = old.items[i];
+        uint32_t extent_end = pos + extent.block_count;
+        uint32_t cut_start = pos > first_block ? pos : first_block;
+        uint32_t cut_end = extent_end < end_block ? extent_end : end_block;
+
+        if (cut_start >= cut_end || extent.start_block == FS_HOLE) {
+            res = list_push(&list, extent.start_block, extent.block_count);
+        } else {
+            uint32_t before = cut_start - pos;
+            res = list_push(&list, extent.start_block, before);
+            if (res == 0) res = list_push(&list, FS_HOLE, cut_end - cut_start);
+            if (res == 0) res = list_push(&list, extent.start_block + (cut_end - pos), extent_end - cut_end);
+        }
+        pos = extent_end;
+    }
+
+    if (res == 0) {
+        res = list_store(state, entry, &list);
+    }
+
+    // بعد از نوشتن نقشه جدید، بلوک‌های سوراخ شده آزاد می‌شوند
+    pos = 0;
+    for (uint32_t i = 0; i < old.count && res == 0; i++) {
+        fs_extent_t extent = old.items[i];
+        uint32_t extent_end = pos + extent.block_count;
+        uint32_t cut_start = pos > first_block ? pos : first_block;
+        uint32_t cut_end = extent_end < end_block ? extent_end : end_block;
+
+        if (cut_start < cut_end && extent.start_block != FS_HOLE) {
+            fs_free_blocks(extent.start_block + (cut_start - pos), cut_end - cut_start, state);
+            entry->alloc_blocks -= cut_end - cut_start;
+        }
+        pos = extent_end;
+    }
+
+    free(old.items);
+    free(list.items);
+    return res;
+}
+
+// تخصیص بلوک (صفر شده) برای حفره‌های داخل [first_block, first_block + block_count)
+int fs_extent_fill(struct fs_state *state, file_entry_t *entry, uint32_t first_block, uint32_t block_count) {
+    if (entry->alloc_blocks == entry->data_blocks || first_block >= entry->data_blocks) {
+        return 0;
+    }
+    if (block_count > entry->data_blocks - first_block) {
+        block_count = entry->data_blocks - first_block;
+    }
+    uint32_t end_block = first_block + block_count;
+
+    // مسیر سریع: حفره‌ای در محدوده نیست
+    int found = 0;
+    uint32_t pos = 0;
+    for (uint32_t i = 0; i < entry->extent_count && pos < end_block && !found; i++) {
+        fs_extent_t extent = get_extent(state, entry, i);
+        found = extent.start_block == FS_HOLE && pos + extent.block_count > first_block;
+        pos += extent.block_count;
+    }
+    if (!found) {
+        return 0;
+    }
+
+    extent_list_t old, list = { 0 }, fresh = { 0 };
+    if (list_load(state, entry, &old) < 0) {
+        return -ENOMEM;
+    }
+
+    int res = 0;
+    pos = 0;
+    for (uint32_t i = 0; i < old.count && res == 0; i++) {
+        fs_extent_t extent = old.items[i];
+        uint32_t extent_end = pos + extent.block_count;
+        uint32_t fill_start = pos > first_block ? pos : first_block;
+        uint32_t fill_end = extent_end < end_block ? extent_end : end_block;
+
+        if (fill_start >= fill_end || extent.start_block != FS_HOLE) {
+            res = list_push(&list, extent.start_block, extent.block_count);
+            pos = extent_end;
+            continue;
+        }
+
+        res = list_push(&list, FS_HOLE, fill_start - pos);
+        uint32_t remaining = fill_end - fill_start;
+        while (res == 0 && remaining > 0) {
+            uint32_t start_block;
+            uint32_t want = fs_alloc_blocks_upto(FS_HOLE, remaining, state, &start_block);
+            if (want == 0) {
+                res = -ENOSPC;
+                break;
+            }
+            res = list_push(&fresh, start_block, want);
+            if (res < 0) {
+                fs_free_blocks(start_block, want, state);
+                break;
+            }
+            res = fs_bdev_io(state, (uint64_t)start_block * BLOCK_SIZE, NULL, NULL, (size_t)want * BLOCK_SIZE);
+            if (res == 0) {
+                res = list_push(&list, start_block, want);
+            }
+            remaining -= want;
+        }
+        if (res == 0) {
+            res = list_push(&list, FS_HOLE, extent_end - fill_end);
+        }
+        pos = extent_end;
+    }
+
+    if (res == 0) {
+        res = list_store(state, entry, &list);
+    }
+
+    uint32_t filled = 0;
+    for (uint32_t i = 0; i < fresh.count; i++) {
+        if (res < 0) {
+            fs_free_blocks(fresh.items[i].start_block, fresh.items[i].block_count, state);
+        }
+        filled += fresh.items[i].block_count;
+    }
+    if (res == 0) {
+        entry->alloc_blocks += filled;
+    }
+
+    free(old.items);
+    free(list.items);
+    free(fresh.items);
+    return res;
+}
+
+// ==================== جابجایی داده (defrag) ====================
+
+// تعداد تکه‌های فیزیکی داده فایل: extentهای داده‌ای که روی دیسک پشت سر هم‌اند
+// (حتی با حفره بین‌شان) یک تکه حساب می‌شوند؛ first_block اولین بلوک داده است
+uint32_t fs_extent_fragments(struct fs_state *state, file_entry_t *entry, uint32_t *first_block) {
+    uint32_t fragments = 0;
+    uint32_t next = FS_HOLE;
+
+    if (first_block) *first_block = FS_HOLE;
+    for (uint32_t i = 0; i < entry->extent_count; i++) {
+        fs_extent_t extent = get_extent(state, entry, i);
+        if (extent.start_block == FS_HOLE) continue;
+
+        if (fragments == 0 && first_block) {
+            *first_block = extent.start_block;
+        }
+        if (extent.start_block != next) {
+            fragments++;
+        }
+        next = extent.start_block + extent.block_count;
+    }
+    return fragments;
+}
+
+// انتقال همه بلوک‌های داده به ترتیب به محدوده پیوسته از start_block
+// (alloc_blocks بلوک که فراخواننده تخصیص داده)؛ حفره‌ها حفره می‌مانند و
+// بلوک‌های قبلی بعد از نوشتن نقشه جدید آزاد می‌شوند
+int fs_extent_relocate(struct fs_state *state, file_entry_t *entry, uint32_t start_block) {
+    extent_list_t old, list = { 0 };
+    if (list_load(state, entry, &old) < 0) {
+        return -ENOMEM;
+    }
+
+    int res = 0;
+    uint32_t target = start_block;
+    for (uint32_t i = 0; i < old.count && res == 0; i++) {
+        fs_extent_t extent = old.items[i];
+        if (extent.start_block == FS_HOLE) {
+            res = list_push(&list, FS_HOLE, extent.block_count);
+            continue;
+        }
+
+        res = fs_bdev_copy(state, target, extent.start_block, extent.block_count);
+        if (res == 0) {
+            res = list_push(&list, target, extent.block_count);
+        }
+        target += extent.block_count;
+    }
+
+    // نقشه جدید بیشتر از قبلی extent ندارد، پس بلوک extent تازه‌ای لازم نیست
+    if (res == 0) {
+        res = list_store(state, entry, &list);
+    }
+
+    for (uint32_t i = 0; i < old.count && res == 0; i++) {
+        if (old.items[i].start_block != FS_HOLE) {
+            fs_free_blocks(old.items[i].start_block, old.items[i].block_count, state);
+        }
+    }
+
+    free(old.items);
+    free(list.items);
+    return res;
+}
+
+// SEEK_DATA / SEEK_HOLE: انتهای فایل هم حفره حساب می‌شود
+off_t fs_extent_seek(struct fs_state *state, file_entry_t *entry, off_t offset, int whence) {
+    if (offset < 0 || (uint64_t)offset >= entry->size) {
+        return -ENXIO;
+    }
+
+    uint64_t pos = 0;
+    for (uint32_t i = 0; i < entry->extent_count && pos < entry->size; i++) {
+        fs_extent_t extent = get_extent(state, entry, i);
+        uint64_t end = pos + (uint64_t)extent.block_count * BLOCK_SIZE;
+        int hole = extent.start_block == FS_HOLE;
+
+        if (end > (uint64_t)offset && hole == (whence == SEEK_HOLE)) {
+            uint64_t found = pos > (uint64_t)offset ? pos : (uint64_t)offset;
+            if (found >= entry->size) break;
+            return found;
+        }
+        pos = end;
+    }
+
+    return whence == SEEK_HOLE ? (off_t)entry->size : -ENXIO;
+}
+
+// کپی بین بافر و داده فایل از دستگاه بلوکی (هر دو بافر NULL یعنی صفر کردن)؛
+// [offset, offset + size) باید داخل نقشه فایل باشد و نوشتن نباید به حفره برسد
+static int extent_copy(struct fs_state *state, file_entry_t *entry, char *out, const char *in,
+                       size_t size, off_t offset) {
+    uint64_t pos = 0;
+
+    for (uint32_t i = 0; i < entry->extent_count && size > 0; i++) {
+        fs_extent_t extent = get_extent(state, entry, i);
+        uint64_t length = (uint64_t)extent.block_count * BLOCK_SIZE;
+
+        if ((uint64_t)offset < pos + length) {
+            uint64_t skip = offset - pos;
+            size_t n = size < length - skip ? size : length - skip;
+
+            if (extent.start_block == FS_HOLE) {
+                if (out) {
+                    memset(out, 0, n);
+                }
+            } else {
+                int res = fs_bdev_io(state, (uint64_t)extent.start_block * BLOCK_SIZE + skip, out, in, n);
+                if (res < 0) {
+                    return res;
+                }
+            }
+            if (out) {
+                out += n;
+            } else if (in) {
+                in += n;
+            }
+            size -= n;
+            offset += n;
+        }
+        pos += length;
+    }
+    return 0;
+}
+
+int fs_extent_read(struct fs_state *state, file_entry_t *entry, char *buf, size_t size, off_t offset) {
+    return extent_copy(state, entry, buf, NULL, size, offset);
+}
+
+int fs_extent_write(struct fs_state *state, file_entry_t *entry, const char *buf, size_t size, off_t offset) {
+    return extent_copy(state, entry, NULL, buf, size, offset);
+}
+
+int fs_extent_zero(struct fs_state *state, file_entry_t *entry, size_t size, off_t offset) {
+    return extent_copy(state, entry, NULL, NULL, size, offset);
+}
+
+// نوشتن بلوک‌های کثیف فایل از کش دستگاه بلوکی (flush و fsync)؛ حفره‌ها رد می‌شوند
+int fs_extent_flush(struct fs_state *state, file_entry_t *entry) {
+    int res = 0;
+
+    for (uint32_t i = 0; i < entry->extent_count; i++) {
+        fs_extent_t extent = get_extent(state, entry, i);
+        if (extent.start_block == FS_HOLE) continue;
+
+        int err = fs_bdev_flush(state, extent.start_block, extent.block_count);
+        if (err < 0 && res == 0) {
+            res = err;
+        }
+    }
+    return res;
+}
+
+// fuse_bufvec برای [offset, offset + size) که مستقیم به فایل image اشاره می‌کند
+// (یک buf برای هر بازه پیوسته روی دیسک) تا libfuse داده را با splice از fd
+// به کرنل بفرستد. محدوده باید داخل فایل باشد؛ اگر به حفره برسد -EAGAIN و
+// فراخواننده از کپی معمولی استفاده می‌کند
+int fs_extent_bufvec(struct fs_state *state, file_entry_t *entry, size_t size, off_t offset,
+                     struct fuse_bufvec **out) {
+    struct fuse_bufvec *bufv = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    uint64_t pos = 0;
+
+    for (uint32_t i = 0; i < entry->extent_count && size > 0; i++) {
+        fs_extent_t extent = get_extent(state, entry, i);
+        uint64_t length = (uint64_t)extent.block_count * BLOCK_SIZE;
+
+        if ((uint64_t)offset < pos + length) {
+            if (extent.start_block == FS_HOLE) {
+                free(bufv);
+                return -EAGAIN;
+            }
+
+            uint64_t skip = offset - pos;
+            size_t n = size < length - skip ? size : length - skip;
+            off_t disk = (off_t)extent.start_block * BLOCK_SIZE + skip;
+
+            struct fuse_buf *last = count ? &bufv->buf[count - 1] : NULL;
+            if (last && last->pos + (off_t)last->size == disk) {
+                last->size += n;
+            } else {
+                if (count == capacity) {
+                    capacity = capacity ? capacity * 2 : 4;
+                    struct fuse_bufvec *grown = realloc(bufv, sizeof(struct fuse_bufvec) +
+                                                        (capacity - 1) * sizeof(struct fuse_buf));
+                    if (!grown) {
+                        free(bufv);
+                        return -ENOMEM;
+                    }
+                    bufv = grown;
+                }
+                bufv->buf[count++] = (struct fuse_buf) {
+                    .size = n,
+                    .flags = FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK,
+                    .fd = state->fd,
+                    .pos = disk,
+                };
+            }
+            size -= n;
+            offset += n;
+        }
+        pos += length;
+    }
+
+    if (!bufv) {
+        return -EAGAIN;
+    }
+    bufv->count = count;
+    bufv->idx = 0;
+    bufv->off = 0;
+    *out = bufv;
+    return 0;
+}
@@ -0,0 +1,290 @@
+#include "general_fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ظرفیت اولیه ایندکس (توانی از دو، حداقل دو برابر MAX_FILES)
+#define INDEX_MIN_CAPACITY 2048
+
+// تابع هش FNV-1a برای (دایرکتوری والد، نام)
+static uint32_t hash_name(uint32_t dir, const char *name) {
+    uint32_t hash = 2166136261u ^ (dir * 0x9E3779B1u);
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// ساخت جدول خالی با ظرفیت مشخص
+static int index_alloc(file_index_t *index, uint32_t capacity) {
+    index->slots = calloc(capacity, sizeof(uint32_t));
+    index->hashes = calloc(capacity, sizeof(uint32_t));
+    if (!index->slots || !index->hashes) {
+        free(index->slots);
+        free(index->hashes);
+        index->slots = NULL;
+        index->hashes = NULL;
+        return -ENOMEM;
+    }
+    index->capacity = capacity;
+    index->count = 0;
+    return 0;
+}
+
+// آرایه‌های فرزندان هر دایرکتوری (dir id از 0 تا ظرفیت جدول)
+static int children_alloc(file_index_t *index, uint32_t capacity) {
+    index->first_child = calloc(capacity + 1, sizeof(uint32_t));
+    index->child_count = calloc(capacity + 1, sizeof(uint32_t));
+    index->next_sibling = calloc(capacity, sizeof(uint32_t));
+    index->prev_sibling = calloc(capacity, sizeof(uint32_t));
+    if (!index->first_child || !index->child_count ||
+        !index->next_sibling || !index->prev_sibling) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+// بزرگ کردن یک آرایه uint32 و صفر کردن بخش جدید
+static int grow_array(uint32_t **array, uint32_t old_count, uint32_t new_count) {
+    uint32_t *bigger = realloc(*array, new_count * sizeof(uint32_t));
+    if (!bigger) {
+        return -ENOMEM;
+    }
+    memset(bigger + old_count, 0, (new_count - old_count) * sizeof(uint32_t));
+    *array = bigger;
+    return 0;
+}
+
+// درج بدون بررسی ظرفیت (probe خطی)
+static void index_put(file_index_t *index, uint32_t hash, uint32_t slot) {
+    uint32_t mask = index->capacity - 1;
+    uint32_t pos = hash & mask;
+
+    while (index->slots[pos] != 0) {
+        pos = (pos + 1) & mask;
+    }
+    index->slots[pos] = slot + 1;
+    index->hashes[pos] = hash;
+    index->count++;
+}
+
+// اضافه کردن اسلات به ابتدای لیست فرزندان والدش
+static void children_link(file_index_t *index, uint32_t dir, uint32_t slot) {
+    uint32_t first = index->first_child[dir];
+
+    index->next_sibling[slot] = first;
+    index->prev_sibling[slot] = 0;
+    if (first != 0) {
+        index->prev_sibling[first - 1] = slot + 1;
+    }
+    index->first_child[dir] = slot + 1;
+    index->child_count[dir]++;
+}
+
+// برداشتن اسلات از لیست فرزندان والدش
+static void children_unlink(file_index_t *index, uint32_t dir, uint32_t slot) {
+    uint32_t next = index->next_sibling[slot];
+    uint32_t prev = index->prev_sibling[slot];
+
+    if (prev != 0) {
+        index->next_sibling[prev - 1] = next;
+    } else {
+        index->first_child[dir] = next;
+    }
+    if (next != 0) {
+        index->prev_sibling[next - 1] = prev;
+    }
+    index->next_sibling[slot] = 0;
+    index->prev_sibling[slot] = 0;
+    index->child_count[dir]--;
+}
+
+// دو برابر کردن ظرفیت وقتی ضریب بار از نصف بیشتر شود
+// lookupهای بدون قفل (locks.c) شاید هنوز آرایه‌های قبلی را بخوانند، پس آن‌ها
+// تا fs_index_free نگه داشته می‌شوند (جمعشان از اندازه آرایه فعلی کمتر است)
+// و ظرفیت بعد از آرایه‌ها منتشر می‌شود تا mask از آرایه دیده شده بزرگ‌تر نباشد
+static int index_grow(file_index_t *index) {
+    file_index_t bigger = *index;
+    if (index_alloc(&bigger, index->capacity * 2) < 0) {
+        return -ENOMEM;
+    }
+
+    void **retired = realloc(index->retired, (index->retired_count + 2) * sizeof(void *));
+    if (!retired) {
+        free(bigger.slots);
+        free(bigger.hashes);
+        return -ENOMEM;
+    }
+    index->retired = retired;
+
+    for (uint32_t i = 0; i < index->capacity; i++) {
+        if (index->slots[i] != 0) {
+            index_put(&bigger, index->hashes[i], index->slots[i] - 1);
+        }
+    }
+
+    retired[index->retired_count++] = index->slots;
+    retired[index->retired_count++] = index->hashes;
+    __atomic_store_n(&index->slots, bigger.slots, __ATOMIC_RELEASE);
+    __atomic_store_n(&index->hashes, bigger.hashes, __ATOMIC_RELEASE);
+    __atomic_store_n(&index->capacity, bigger.capacity, __ATOMIC_RELEASE);
+    index->count = bigger.count;
+    return 0;
+}
+
+// پیدا کردن اسلات (dir, name) در جدول هش؛ در صورت نبود -1
+// بدون قفل هم امن است: ظرفیت قبل از آرایه‌ها خوانده می‌شود (index_grow)
+static int32_t index_find(file_index_t *index, uint32_t dir, const char *name,
+                          uint32_t hash, struct fs_state *state) {
+    uint32_t mask = __atomic_load_n(&index->capacity, __ATOMIC_ACQUIRE) - 1;
+    uint32_t *slots = __atomic_load_n(&index->slots, __ATOMIC_ACQUIRE);
+    uint32_t *hashes = __atomic_load_n(&index->hashes, __ATOMIC_ACQUIRE);
+    uint32_t pos = hash & mask;
+
+    while (slots[pos] != 0) {
+        uint32_t slot = slots[pos] - 1;
+        if (hashes[pos] == hash &&
+            fs_entry(state, slot)->parent == dir &&
+            strcmp(fs_entry_name(state, slot), name) == 0) {
+            return slot;
+        }
+        pos = (pos + 1) & mask;
+    }
+    return -1;
+}
+
+// پر کردن ایندکس خالی از روی جدول فایل
+static void index_fill(struct fs_state *state) {
+    file_index_t *index = &state->file_index;
+
+    for (uint32_t i = 0; i < state->superblock->slot_count; i++) {
+        file_entry_t *entry = fs_entry(state, i);
+        // بدون نام: حذف شده ولی هنوز باز (fs_reclaim_orphans)
+        if (entry->type == FS_TYPE_FREE || fs_entry_name(state, i)[0] == '\0') continue;
+        index_put(index, hash_name(entry->parent, fs_entry_name(state, i)), i);
+        children_link(index, entry->parent, i);
+    }
+}
+
+// ساخت مجدد ایندکس از روی جدول فایل (هنگام mount)
+int fs_index_build(struct fs_state *state) {
+    if (!state) return -EINVAL;
+
+    fs_index_free(state);
+
+    uint32_t capacity = INDEX_MIN_CAPACITY;
+    while (capacity < state->superblock->file_count * 2) {
+        capacity *= 2;
+    }
+
+    if (index_alloc(&state->file_index, capacity) < 0 ||
+        children_alloc(&state->file_index, fs_table_capacity(state)) < 0) {
+        fs_index_free(state);
+        return -ENOMEM;
+    }
+
+    index_fill(state);
+    return 0;
+}
+
+void fs_index_free(struct fs_state *state) {
+    if (!state) return;
+
+    file_index_t *index = &state->file_index;
+    free(index->slots);
+    free(index->hashes);
+    free(index->first_child);
+    free(index->child_count);
+    free(index->next_sibling);
+    free(index->prev_sibling);
+    for (uint32_t i = 0; i < index->retired_count; i++) {
+        free(index->retired[i]);
+    }
+    free(index->retired);
+    memset(index, 0, sizeof(file_index_t));
+}
+
+// هم‌اندازه کردن لیست‌های فرزندان با ظرفیت جدید جدول فایل
+int fs_index_resize(struct fs_state *state, uint32_t capacity) {
+    file_index_t *index = &state->file_index;
+    uint32_t old = fs_table_capacity(state);
+
+    if (grow_array(&index->first_child, old + 1, capacity + 1) < 0 ||
+        grow_array(&index->child_count, old + 1, capacity + 1) < 0 ||
+        grow_array(&index->next_sibling, old, capacity) < 0 ||
+        grow_array(&index->prev_sibling, old, capacity) < 0) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+// اضافه کردن اسلات جدید به ایندکس و به لیست فرزندان والدش
+int fs_index_insert(struct fs_state *state, uint32_t slot) {
+    file_index_t *index = &state->file_index;
+    file_entry_t *entry = fs_entry(state, slot);
+
+    if ((index->count + 1) * 2 > index->capacity) {
+        if (index_grow(index) < 0) {
+            return -ENOMEM;
+        }
+    }
+
+    index_put(index, hash_name(entry->parent, fs_entry_name(state, slot)), slot);
+    children_link(index, entry->parent, slot);
+    return 0;
+}
+
+// حذف اسلات از جدول هش (backward shift) و از لیست فرزندان والدش
+// باید قبل از پاک شدن نام و والد entry صدا زده شود
+void fs_index_remove(struct fs_state *state, uint32_t slot) {
+    file_index_t *index = &state->file_index;
+    file_entry_t *entry = fs_entry(state, slot);
+    uint32_t mask = index->capacity - 1;
+    uint32_t pos = hash_name(entry->parent, fs_entry_name(state, slot)) & mask;
+
+    while (index->slots[pos] != slot + 1) {
+        if (index->slots[pos] == 0) return;
+        pos = (pos + 1) & mask;
+    }
+
+    // entryهای بعدی زنجیره را به جای خالی می‌کشیم تا probe قطع نشود
+    uint32_t hole = pos;
+    uint32_t next = (pos + 1) & mask;
+    while (index->slots[next] != 0) {
+        uint32_t home = index->hashes[next] & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            index->slots[hole] = index->slots[next];
+            index->hashes[hole] = index->hashes[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    index->slots[hole] = 0;
+    index->hashes[hole] = 0;
+    index->count--;
+
+    children_unlink(index, entry->parent, slot);
+}
+
+// جستجوی نام در یک دایرکتوری؛ در صورت نبود -1 برمی‌گرداند
+int32_t fs_index_lookup(struct fs_state *state, uint32_t dir, const char *name) {
+    file_index_t *index = &state->file_index;
+    if (!index->slots) return -1;
+
+    return index_find(index, dir, name, hash_name(dir, name), state);
+}
+
+// اولین فرزند دایرکتوری؛ در صورت نبود -1
+int32_t fs_index_first_child(struct fs_state *state, uint32_t dir) {
+    return (int32_t)state->file_index.first_child[dir] - 1;
+}
+
+// فرزند بعدی همان دایرکتوری؛ در صورت نبود -1
+int32_t fs_index_next_child(struct fs_state *state, uint32_t slot) {
+    return (int32_t)state->file_index.next_sibling[slot] - 1;
+}
+
+uint32_t fs_index_child_count(struct fs_state *state, uint32_t dir) {
+    return state->file_index.child_count[dir];
+}
@@ -11,158 +11,587 @@ static uint32_t block_to_offset(uint32_t block) {
     return block * BLOCK_SIZE;
 }
 
-// ایجاد یک گره جدید در لیست بلوک‌های خالی
-static free_block_t *create_free_block(uint32_t start_block, uint32_t block_count) {
-    free_block_t *new_block = malloc(sizeof(free_block_t));
-    if (!new_block) return NULL;
+// ==================== درخت‌های AVL ====================
+// هر بلوک خالی هم‌زمان در دو درخت است؛ tree یکی از FREE_BY_OFFSET یا FREE_BY_SIZE
+
+// مقایسه کلید دو گره در یک درخت (کلیدها یکتا هستند)
+static int key_less(const free_block_t *a, const free_block_t *b, int tree) {
+    if (tree == FREE_BY_SIZE && a->block_count != b->block_count) {
+        return a->block_count < b->block_count;
+    }
+    return a->start_block < b->start_block;
+}
+
+static int node_height(const free_block_t *node, int tree) {
+    return node ? node->height[tree] : 0;
+}
+
+static void update_height(free_block_t *node, int tree) {
+    int left = node_height(node->child[tree][0], tree);
+    int right = node_height(node->child[tree][1], tree);
+    node->height[tree] = (left > right ? left : right) + 1;
+}
+
+// چرخش: dir صفر یعنی چرخش به چپ و یک یعنی چرخش به راست
+static free_block_t *rotate(free_block_t *node, int tree, int dir) {
+    free_block_t *up = node->child[tree][!dir];
+    node->child[tree][!dir] = up->child[tree][dir];
+    up->child[tree][dir] = node;
+    update_height(node, tree);
+    update_height(up, tree);
+    return up;
+}
+
+static free_block_t *rebalance(free_block_t *node, int tree) {
+    update_height(node, tree);
+    int balance = node_height(node->child[tree][0], tree) - node_height(node->child[tree][1], tree);
     
-    new_block->start_block = start_block;
-    new_block->block_count = block_count;
-    new_block->next = NULL;
+    if (balance > 1) {
+        free_block_t *left = node->child[tree][0];
+        if (node_height(left->child[tree][0], tree) < node_height(left->child[tree][1], tree)) {
+            node->child[tree][0] = rotate(left, tree, 0);
+        }
+        return rotate(node, tree, 1);
+    }
+    if (balance < -1) {
+        free_block_t *right = node->child[tree][1];
+        if (node_height(right->child[tree][1], tree) < node_height(right->child[tree][0], tree)) {
+            node->child[tree][1] = rotate(right, tree, 1);
+        }
+        return rotate(node, tree, 0);
+    }
+    return node;
+}
+
+static free_block_t *tree_insert(free_block_t *root, free_block_t *node, int tree) {
+    if (!root) {
+        node->child[tree][0] = NULL;
+        node->child[tree][1] = NULL;
+        node->height[tree] = 1;
+        return node;
+    }
     
-    return new_block;
+    int side = !key_less(node, root, tree);
+    root->child[tree][side] = tree_insert(root->child[tree][side], node, tree);
+    return rebalance(root, tree);
 }
 
-// درج یک بلوک خالی در لیست به‌صورت مرتب
-static int insert_free_block(free_block_t **head, free_block_t *new_block) {
-    if (!new_block) return -1;
+static free_block_t *tree_remove_min(free_block_t *root, int tree, free_block_t **min) {
+    if (!root->child[tree][0]) {
+        *min = root;
+        return root->child[tree][1];
+    }
+    root->child[tree][0] = tree_remove_min(root->child[tree][0], tree, min);
+    return rebalance(root, tree);
+}
+
+// حذف گره (کلید گره نباید قبل از حذف تغییر کرده باشد)
+static free_block_t *tree_remove(free_block_t *root, free_block_t *node, int tree) {
+    if (!root) return NULL;
     
-    // اگر لیست خالی است
-    if (*head == NULL) {
-        *head = new_block;
-        return 0;
+    if (root == node) {
+        free_block_t *left = root->child[tree][0];
+        free_block_t *right = root->child[tree][1];
+        if (!right) return left;
+        
+        free_block_t *min;
+        right = tree_remove_min(right, tree, &min);
+        min->child[tree][0] = left;
+        min->child[tree][1] = right;
+        return rebalance(min, tree);
     }
     
-    free_block_t *current = *head;
-    free_block_t *prev = NULL;
+    int side = !key_less(node, root, tree);
+    root->child[tree][side] = tree_remove(root->child[tree][side], node, tree);
+    return rebalance(root, tree);
+}
+
+// آخرین بلوک خالی که از block یا قبل از آن شروع می‌شود
+static free_block_t *find_floor(fs_alloc_group_t *group, uint32_t block) {
+    free_block_t *node = group->free_tree[FREE_BY_OFFSET];
+    free_block_t *found = NULL;
     
-    // پیدا کردن موقعیت مناسب برای درج (مرتب بر اساس start_block)
-    while (current && current->start_block < new_block->start_block) {
-        prev = current;
-        current = current->next;
+    while (node) {
+        if (node->start_block <= block) {
+            found = node;
+            node = node->child[FREE_BY_OFFSET][1];
+        } else {
+            node = node->child[FREE_BY_OFFSET][0];
+        }
+    }
+    return found;
+}
+
+// کوچک‌ترین بلوک خالی با حداقل block_count بلوک (best-fit، در تساوی کمترین آفست)
+static free_block_t *find_best_fit(fs_alloc_group_t *group, uint32_t block_count) {
+    free_block_t *node = group->free_tree[FREE_BY_SIZE];
+    free_block_t *found = NULL;
+    
+    while (node) {
+        if (node->block_count >= block_count) {
+            found = node;
+            node = node->child[FREE_BY_SIZE][0];
+        } else {
+            node = node->child[FREE_BY_SIZE][1];
+        }
+    }
+    return found;
+}
+
+// ==================== عملیات روی extentهای خالی ====================
+// همه زیر قفل گروه؛ extent هیچ‌وقت از مرز گروهش رد نمی‌شود
+
+// گره‌ها از pool گروه گرفته می‌شوند (اولین بار pool ساخته می‌شود)
+static free_block_t *node_alloc(fs_alloc_group_t *group) {
+    if (!group->pool.object_size) {
+        fs_pool_init(&group->pool, sizeof(free_block_t));
     }
+    return fs_pool_alloc(&group->pool);
+}
+
+// اضافه کردن extent جدید بعد از prev در لیست گروه (prev صفر یعنی ابتدای لیست)
+static free_block_t *extent_add(struct fs_state *state, fs_alloc_group_t *group, free_block_t *prev,
+                                uint32_t start_block, uint32_t block_count) {
+    free_block_t *node = node_alloc(group);
+    if (!node) return NULL;
     
-    // درج در ابتدای لیست
-    if (prev == NULL) {
-        new_block->next = *head;
-        *head = new_block;
+    node->start_block = start_block;
+    node->block_count = block_count;
+    node->prev = prev;
+    node->next = prev ? prev->next : group->free_list;
+    if (node->next) {
+        node->next->prev = node;
+    }
+    if (prev) {
+        prev->next = node;
     } else {
-        // درج در میانه یا انتهای لیست
-        new_block->next = current;
-        prev->next = new_block;
+        group->free_list = node;
     }
     
-    return 0;
+    group->free_tree[FREE_BY_OFFSET] = tree_insert(group->free_tree[FREE_BY_OFFSET], node, FREE_BY_OFFSET);
+    group->free_tree[FREE_BY_SIZE] = tree_insert(group->free_tree[FREE_BY_SIZE], node, FREE_BY_SIZE);
+    group->free_blocks += block_count;
+    // شمارنده extentها بین همه گروه‌ها مشترک است
+    __atomic_add_fetch(&state->superblock->free_block_count, 1, __ATOMIC_RELAXED);
+    return node;
 }
 
-// ادغام بلوک‌های خالی مجاور
-static void merge_free_blocks(free_block_t *head) {
-    free_block_t *current = head;
+static void extent_remove(struct fs_state *state, fs_alloc_group_t *group, free_block_t *node) {
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        group->free_list = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    }
     
-    while (current && current->next) {
-        // اگر بلوک فعلی و بعدی مجاور هم هستند
-        if ((current->start_block + current->block_count) == current->next->start_block) {
-            // ادغام بلوک‌ها
-            current->block_count += current->next->block_count;
-            
-            // حذف بلوک بعدی
-            free_block_t *to_delete = current->next;
-            current->next = to_delete->next;
-            free(to_delete);
+    group->free_tree[FREE_BY_OFFSET] = tree_remove(group->free_tree[FREE_BY_OFFSET], node, FREE_BY_OFFSET);
+    group->free_tree[FREE_BY_SIZE] = tree_remove(group->free_tree[FREE_BY_SIZE], node, FREE_BY_SIZE);
+    group->free_blocks -= node->block_count;
+    __atomic_sub_fetch(&state->superblock->free_block_count, 1, __ATOMIC_RELAXED);
+    fs_pool_free(&group->pool, node);
+}
+
+// تغییر محدوده یک extent؛ ترتیب آن نسبت به همسایه‌ها نباید عوض شود،
+// پس درخت آفست دست نمی‌خورد و فقط درخت اندازه به‌روز می‌شود
+static void extent_resize(fs_alloc_group_t *group, free_block_t *node,
+                          uint32_t start_block, uint32_t block_count) {
+    group->free_tree[FREE_BY_SIZE] = tree_remove(group->free_tree[FREE_BY_SIZE], node, FREE_BY_SIZE);
+    group->free_blocks += block_count - node->block_count;
+    node->start_block = start_block;
+    node->block_count = block_count;
+    group->free_tree[FREE_BY_SIZE] = tree_insert(group->free_tree[FREE_BY_SIZE], node, FREE_BY_SIZE);
+}
+
+// ==================== bitmap روی دیسک ====================
+// درخت‌ها فقط در حافظه‌اند؛ bitmap با هر تخصیص و آزادسازی به‌روز می‌شود
+// و هنگام mount درخت‌ها از روی آن ساخته می‌شوند
+
+// تنظیم بیت‌های یک محدوده؛ تعداد بیت‌هایی که از قبل همین مقدار را داشتند برمی‌گردد
+// (بیرون از این فایل فقط هنگام mount که هنوز نخ دیگری نیست؛ مرز گروه‌ها مضرب 64
+// بلوک است پس دو گروه هیچ‌وقت یک بایت bitmap را با هم تغییر نمی‌دهند)
+uint32_t fs_bitmap_mark(struct fs_state *state, uint32_t start_block, uint32_t block_count, int used) {
+    uint8_t *bitmap = state->block_bitmap;
+    if (!bitmap || start_block >= FS_TOTAL_BLOCKS) return 0;
+    
+    uint32_t end_block = start_block + block_count;
+    if (end_block > FS_TOTAL_BLOCKS || end_block < start_block) {
+        end_block = FS_TOTAL_BLOCKS;
+    }
+    
+    uint32_t already = 0;
+    for (uint32_t block = start_block; block < end_block; block++) {
+        uint8_t bit = 1 << (block % 8);
+        if (!!(bitmap[block / 8] & bit) == !!used) {
+            already++;
+        }
+        if (used) {
+            bitmap[block / 8] |= bit;
         } else {
-            current = current->next;
+            bitmap[block / 8] &= ~bit;
         }
     }
+    return already;
 }
 
-// تخصیص بلوک از لیست بلوک‌های خالی
-int fs_alloc_blocks(uint32_t block_count, struct fs_state *state, uint32_t *start_block) {
-    if (block_count == 0 || !state || !start_block) return -1;
+// تخصیص بلوک از بلوک‌های خالی گروه (best-fit، O(log n))
+static int alloc_blocks(struct fs_state *state, fs_alloc_group_t *group,
+                        uint32_t block_count, uint32_t *start_block) {
+    
+    free_block_t *node = find_best_fit(group, block_count);
+    if (!node) {
+        return -ENOSPC;
+    }
+    
+    *start_block = node->start_block;
+    
+    if (node->block_count == block_count) {
+        // حذف کامل بلوک از لیست
+        extent_remove(state, group, node);
+    } else {
+        // کاهش اندازه بلوک
+        extent_resize(group, node, node->start_block + block_count, node->block_count - block_count);
+    }
+    fs_bitmap_mark(state, *start_block, block_count, 1);
+    fs_discard_cancel(state, *start_block, block_count);
+    
+    fs_log_debug("Allocated %u blocks starting at block %u", block_count, *start_block);
+    return 0;
+}
+
+// علامت زدن یک محدوده داخل گروه به عنوان استفاده شده (برداشتن آن از بلوک‌های خالی)
+static int reserve_blocks(struct fs_state *state, fs_alloc_group_t *group,
+                          uint32_t start_block, uint32_t block_count) {
+    
+    uint32_t end_block = start_block + block_count;
+    free_block_t *node = find_floor(group, start_block);
+    if (!node || node->start_block + node->block_count <= start_block) {
+        node = node ? node->next : group->free_list;
+    }
+    
+    while (node && node->start_block < end_block) {
+        free_block_t *next = node->next;
+        free_block_t *prev = node->prev;
+        uint32_t node_start = node->start_block;
+        uint32_t node_end = node_start + node->block_count;
+    
+        extent_remove(state, group, node);
+    
+        // بخش‌های قبل و بعد از محدوده خالی می‌مانند
+        if (node_start < start_block) {
+            prev = extent_add(state, group, prev, node_start, start_block - node_start);
+            if (!prev) return -ENOMEM;
+        }
+        if (node_end > end_block) {
+            if (!extent_add(state, group, prev, end_block, node_end - end_block)) return -ENOMEM;
+        }
+    
+        node = next;
+    }
+    
+    fs_bitmap_mark(state, start_block, block_count, 1);
+    fs_discard_cancel(state, start_block, block_count);
+    return 0;
+}
+
+// تخصیص حداکثر max_count بلوک دقیقاً از start_block (برای بزرگ کردن فایل در جا)
+// تعداد بلوک‌های تخصیص داده شده برمی‌گردد (صفر اگر start_block خالی نباشد)
+static uint32_t alloc_blocks_at(struct fs_state *state, fs_alloc_group_t *group,
+                                uint32_t start_block, uint32_t max_count) {
+    free_block_t *node = find_floor(group, start_block);
+    if (!node || node->start_block + node->block_count <= start_block) {
+        return 0;
+    }
+    
+    uint32_t count = node->start_block + node->block_count - start_block;
+    if (count > max_count) {
+        count = max_count;
+    }
+    if (reserve_blocks(state, group, start_block, count) < 0) {
+        return 0;
+    }
+    
+    fs_log_debug("Allocated %u blocks starting at block %u", count, start_block);
+    return count;
+}
+
+// اندازه بزرگ‌ترین extent خالی گروه (راست‌ترین گره درخت اندازه)
+static uint32_t largest_free(fs_alloc_group_t *group) {
+    free_block_t *node = group->free_tree[FREE_BY_SIZE];
+    if (!node) return 0;
+    
+    while (node->child[FREE_BY_SIZE][1]) {
+        node = node->child[FREE_BY_SIZE][1];
+    }
+    return node->block_count;
+}
+
+// آزادسازی بلوک‌های داخل گروه و ادغام با همسایه‌های مجاور (O(log n))
+static int free_blocks(struct fs_state *state, fs_alloc_group_t *group,
+                       uint32_t start_block, uint32_t block_count) {
+    fs_log_debug("Freeing %u blocks starting at block %u", block_count, start_block);
     
-    free_block_t *current = state->free_list;
-    free_block_t *prev = NULL;
+    uint32_t end_block = start_block + block_count;
+    free_block_t *prev = find_floor(group, start_block);
+    free_block_t *next = prev ? prev->next : group->free_list;
     
-    // جستجوی اولین بلوک خالی با اندازه کافی (First Fit)
-    while (current) {
-        if (current->block_count >= block_count) {
-            *start_block = current->start_block;
+    // محدوده نباید با بلوک‌های خالی موجود هم‌پوشانی داشته باشد
+    if ((prev && prev->start_block + prev->block_count > start_block) ||
+        (next && next->start_block < end_block)) {
+        fs_log_error("blocks %u-%u are already free", start_block, end_block - 1);
+        return -EINVAL;
+    }
+    
+    int merge_prev = prev && prev->start_block + prev->block_count == start_block;
+    int merge_next = next && next->start_block == end_block;
+    
+    free_block_t *merged;
+    if (merge_prev && merge_next) {
+        uint32_t total = prev->block_count + block_count + next->block_count;
+        extent_remove(state, group, next);
+        extent_resize(group, prev, prev->start_block, total);
+        merged = prev;
+    } else if (merge_prev) {
+        extent_resize(group, prev, prev->start_block, prev->block_count + block_count);
+        merged = prev;
+    } else if (merge_next) {
+        extent_resize(group, next, start_block, next->block_count + block_count);
+        merged = next;
+    } else if (!(merged = extent_add(state, group, prev, start_block, block_count))) {
+        return -ENOMEM;
+    }
+    
+    fs_bitmap_mark(state, start_block, block_count, 0);
+    
+    // بازه خالی بعد از ادغام برای پانچ در فایل image صف می‌شود
+    fs_discard_queue(state, merged->start_block, merged->block_count);
+    return 0;
+}
+
+// ==================== گروه‌های تخصیص ====================
+// فضای بلوک‌ها به یک گروه برای هر CPU تقسیم شده و هر گروه درخت‌ها، لیست،
+// pool گره و قفل خودش را دارد. فایلی که داده دارد کنار داده قبلی‌اش (در همان
+// گروه) رشد می‌کند و بقیه تخصیص‌ها از گروه خانگی نخ فراخواننده است؛ اگر
+// آن گروه جا نداشت به نوبت از گروه‌های بعدی برداشته می‌شود
+
+// گروه خانگی نخ فعلی؛ هر نخ بار اول به نوبت یک گروه می‌گیرد
+static __thread uint32_t home_group = UINT32_MAX;
+
+static uint32_t thread_group(struct fs_state *state) {
+    if (home_group == UINT32_MAX) {
+        home_group = __atomic_fetch_add(&state->alloc_next_group, 1, __ATOMIC_RELAXED);
+    }
+    return home_group % state->alloc_group_count;
+}
+
+// گروهی که block در آن است (گروه آخر تا انتهای فضای بلوک‌ها ادامه دارد)
+static uint32_t group_of(struct fs_state *state, uint32_t block) {
+    uint32_t group = block / state->alloc_group_blocks;
+    return group < state->alloc_group_count ? group : state->alloc_group_count - 1;
+}
+
+// اولین بلوک بعد از گروه
+static uint32_t group_end(struct fs_state *state, uint32_t group) {
+    return group + 1 < state->alloc_group_count ? (group + 1) * state->alloc_group_blocks : UINT32_MAX;
+}
+
+// اجرای op روی بخش هر گروه از یک محدوده، هر بخش زیر قفل گروه خودش
+static int range_op(struct fs_state *state, uint32_t start_block, uint32_t block_count,
+                    int (*op)(struct fs_state *, fs_alloc_group_t *, uint32_t, uint32_t)) {
+    uint32_t end_block = start_block + block_count;
+    int res = 0;
+    
+    while (res == 0 && start_block < end_block) {
+        uint32_t index = group_of(state, start_block);
+        uint32_t piece_end = group_end(state, index);
+        if (piece_end > end_block) {
+            piece_end = end_block;
+        }
+        
+        fs_alloc_group_t *group = &state->alloc_groups[index];
+        pthread_mutex_lock(&group->lock);
+        res = op(state, group, start_block, piece_end - start_block);
+        pthread_mutex_unlock(&group->lock);
+        start_block = piece_end;
+    }
+    return res;
+}
+
+// ==================== رابط عمومی (زیر قفل گروه) ====================
+
+// تخصیص ترجیحاً در گروه goal_block (FS_HOLE یعنی گروه خانگی نخ)
+int fs_alloc_blocks_near(uint32_t goal_block, uint32_t block_count, struct fs_state *state,
+                         uint32_t *start_block) {
+    if (block_count == 0 || !state || !start_block || !state->alloc_group_count) return -1;
+    
+    uint32_t first = goal_block == FS_HOLE ? thread_group(state) : group_of(state, goal_block);
+    for (uint32_t i = 0; i < state->alloc_group_count; i++) {
+        fs_alloc_group_t *group = &state->alloc_groups[(first + i) % state->alloc_group_count];
+        
+        pthread_mutex_lock(&group->lock);
+        int res = alloc_blocks(state, group, block_count, start_block);
+        pthread_mutex_unlock(&group->lock);
+        if (res == 0) return 0;
+    }
+    
+    fs_log_error("Not enough free blocks (needed: %u)", block_count);
+    return -ENOSPC;
+}
+
+int fs_alloc_blocks(uint32_t block_count, struct fs_state *state, uint32_t *start_block) {
+    return fs_alloc_blocks_near(FS_HOLE, block_count, state, start_block);
+}
+
+// تا max_count بلوک پیوسته نزدیک goal_block؛ تعداد بلوک‌های گرفته شده، صفر اگر
+// هیچ بلوک خالی نیست. اگر هیچ گروهی کل محدوده را جا ندهد، بزرگ‌ترین extent
+// گرفته می‌شود و اندازه آن زیر قفل همان گروه دوباره خوانده می‌شود تا نویسنده
+// هم‌زمانی که بین پیمایش و تخصیص آن را کوچک کرده باعث ENOSPC نشود
+uint32_t fs_alloc_blocks_upto(uint32_t goal_block, uint32_t max_count, struct fs_state *state,
+                              uint32_t *start_block) {
+    if (max_count == 0 || !state || !start_block || !state->alloc_group_count) return 0;
+    
+    uint32_t first = goal_block == FS_HOLE ? thread_group(state) : group_of(state, goal_block);
+    for (;;) {
+        fs_alloc_group_t *best = NULL;
+        uint32_t best_size = 0;
+        
+        for (uint32_t i = 0; i < state->alloc_group_count; i++) {
+            fs_alloc_group_t *group = &state->alloc_groups[(first + i) % state->alloc_group_count];
             
-            // اگر بلوک دقیقاً به اندازه نیاز باشد
-            if (current->block_count == block_count) {
-                // حذف کامل بلوک از لیست
-                if (prev) {
-                    prev->next = current->next;
-                } else {
-                    state->free_list = current->next;
-                }
-                free(current);
-            } else {
-                // کاهش اندازه بلوک
-                current->start_block += block_count;
-                current->block_count -= block_count;
-            }
+            pthread_mutex_lock(&group->lock);
+            uint32_t size = largest_free(group);
+            int res = size >= max_count ? alloc_blocks(state, group, max_count, start_block) : -ENOSPC;
+            pthread_mutex_unlock(&group->lock);
+            if (res == 0) return max_count;
             
-            state->superblock->free_block_count--;
-            printf("Allocated %u blocks starting at block %u\n", block_count, *start_block);
-            return 0;
+            if (size > best_size) {
+                best = group;
+                best_size = size;
+            }
         }
+        if (!best) return 0;
         
-        prev = current;
-        current = current->next;
+        pthread_mutex_lock(&best->lock);
+        uint32_t count = largest_free(best);
+        if (count > max_count) {
+            count = max_count;
+        }
+        int res = count > 0 ? alloc_blocks(state, best, count, start_block) : -ENOSPC;
+        pthread_mutex_unlock(&best->lock);
+        if (res == 0) return count;
     }
+}
+
+int fs_reserve_blocks(uint32_t start_block, uint32_t block_count, struct fs_state *state) {
+    if (block_count == 0 || !state || !state->alloc_group_count) return -1;
     
-    // اگر فضای خالی کافی پیدا نشد
-    printf("Error: Not enough free blocks (needed: %u)\n", block_count);
-    return -ENOSPC;
+    return range_op(state, start_block, block_count, reserve_blocks);
 }
 
-// آزادسازی بلوک و اضافه کردن به لیست بلوک‌های خالی
+// در جا فقط تا انتهای گروه start_block؛ فراخواننده بقیه را با تخصیص
+// نزدیک به همین بلوک (که در گروه بعدی است) ادامه می‌دهد
+uint32_t fs_alloc_blocks_at(uint32_t start_block, uint32_t max_count, struct fs_state *state) {
+    if (max_count == 0 || !state || !state->alloc_group_count) return 0;
+    
+    fs_alloc_group_t *group = &state->alloc_groups[group_of(state, start_block)];
+    pthread_mutex_lock(&group->lock);
+    uint32_t count = alloc_blocks_at(state, group, start_block, max_count);
+    pthread_mutex_unlock(&group->lock);
+    return count;
+}
+
+// بزرگ‌ترین extent خالی در همه گروه‌ها
+uint32_t fs_largest_free(struct fs_state *state) {
+    uint32_t largest = 0;
+    
+    for (uint32_t i = 0; i < state->alloc_group_count; i++) {
+        fs_alloc_group_t *group = &state->alloc_groups[i];
+        pthread_mutex_lock(&group->lock);
+        uint32_t size = largest_free(group);
+        pthread_mutex_unlock(&group->lock);
+        if (size > largest) {
+            largest = size;
+        }
+    }
+    return largest;
+}
+
+// محدوده‌ای که از مرز گروه رد می‌شود (extent فایلی که در جا رشد کرده)
+// در هر گروه جدا آزاد می‌شود
 int fs_free_blocks(uint32_t start_block, uint32_t block_count, struct fs_state *state) {
-    if (block_count == 0 || !state) return -1;
+    if (block_count == 0 || !state || !state->alloc_group_count) return -1;
     
-    printf("Freeing %u blocks starting at block %u\n", block_count, start_block);
+    // نسخه کش شده بلوک‌ها قبل از اینکه دوباره تخصیص داده شوند دور ریخته می‌شود
+    fs_bdev_forget(state, start_block, block_count);
     
-    // ایجاد گره جدید برای بلوک آزاد شده
-    free_block_t *freed_block = create_free_block(start_block, block_count);
-    if (!freed_block) return -ENOMEM;
+    return range_op(state, start_block, block_count, free_blocks);
+}
+
+// مجموع بلوک‌های خالی همه گروه‌ها
+uint32_t fs_free_total(struct fs_state *state) {
+    uint32_t total = 0;
     
-    // درج بلوک آزاد شده در لیست
-    if (insert_free_block(&state->free_list, freed_block) < 0) {
-        free(freed_block);
-        return -1;
+    for (uint32_t i = 0; i < state->alloc_group_count; i++) {
+        fs_alloc_group_t *group = &state->alloc_groups[i];
+        pthread_mutex_lock(&group->lock);
+        total += group->free_blocks;
+        pthread_mutex_unlock(&group->lock);
     }
+    return total;
+}
+
+// پیمایش extentهای خالی به ترتیب آفست، هر گروه زیر قفل خودش
+// مقدار غیر صفر visit پیمایش را متوقف می‌کند
+void fs_free_walk(struct fs_state *state, int (*visit)(const free_block_t *node, void *arg), void *arg) {
+    int stop = 0;
     
-    // ادغام بلوک‌های مجاور
-    merge_free_blocks(state->free_list);
-    
-    state->superblock->free_block_count++;
+    for (uint32_t i = 0; i < state->alloc_group_count && !stop; i++) {
+        fs_alloc_group_t *group = &state->alloc_groups[i];
+        pthread_mutex_lock(&group->lock);
+        for (free_block_t *node = group->free_list; node && !stop; node = node->next) {
+            stop = visit(node, arg);
+        }
+        pthread_mutex_unlock(&group->lock);
+    }
+}
+
+static int print_visit(const free_block_t *node, void *arg) {
+    int *i = arg;
+    printf("%d. Start block: %u, Block count: %u, Size: %u KB\n", 
+           (*i)++, 
+           node->start_block,
+           node->block_count,
+           node->block_count * BLOCK_SIZE / 1024);
     return 0;
 }
 
 // نمایش لیست بلوک‌های خالی
 void fs_print_free_list(struct fs_state *state) {
-    if (!state || !state->free_list) {
+    if (!state || state->superblock->free_block_count == 0) {
         printf("Free list is empty\n");
         return;
     }
     
     printf("=== Free Block List ===\n");
     printf("Total free blocks in list: %u\n", state->superblock->free_block_count);
+    printf("Allocation groups: %u x %u blocks\n", state->alloc_group_count, state->alloc_group_blocks);
     
-    free_block_t *current = state->free_list;
     int i = 1;
-    
-    while (current) {
-        printf("%d. Start block: %u, Block count: %u, Size: %u KB\n", 
-               i++, 
-               current->start_block,
-               current->block_count,
-               current->block_count * BLOCK_SIZE / 1024);
-        current = current->next;
-    }
+    fs_free_walk(state, print_visit, &i);
     printf("=======================\n");
 }
 
+static int visualize_visit(const free_block_t *node, void *arg) {
+    char *visual = arg;
+    for (uint32_t i = 0; i < node->block_count; i++) {
+        if (node->start_block + i < FS_SIZE / BLOCK_SIZE) {
+            visual[node->start_block + i] = '.';
+        }
+    }
+    return 0;
+}
+
 // نمایش بصری فضای خالی
 void fs_visualize_free_space(struct fs_state *state) {
     if (!state) return;
@@ -181,15 +610,7 @@ void fs_visualize_free_space(struct fs_state *state) {
     visual[total_blocks] = '\0';
     
     // علامت‌گذاری بلوک‌های خالی
-    free_block_t *current = state->free_list;
-    while (current) {
-        for (uint32_t i = 0; i < current->block_count; i++) {
-            if (current->start_block + i < total_blocks) {
-                visual[current->start_block + i] = '.';
-            }
-        }
-        current = current->next;
-    }
+    fs_free_walk(state, visualize_visit, visual);
     
     // نمایش وضعیت بلوک‌ها
     printf("Total blocks: %u (%u MB)\n", total_blocks, FS_SIZE / (1024 * 1024));
@@ -210,12 +631,7 @@ void fs_visualize_free_space(struct fs_state *state) {
     }
     
     // آمار
-    uint32_t free_blocks_count = 0;
-    current = state->free_list;
-    while (current) {
-        free_blocks_count += current->block_count;
-        current = current->next;
-    }
+    uint32_t free_blocks_count = fs_free_total(state);
     
     uint32_t used_blocks = total_blocks - free_blocks_count;
     printf("\nStatistics:\n");
@@ -227,23 +643,79 @@ void fs_visualize_free_space(struct fs_state *state) {
     free(visual);
 }
 
-// مقداردهی اولیه لیست بلوک‌های خالی
+// ساخت گروه‌های تخصیص و درخت‌های بلوک‌های خالی از روی bitmap دیسک
+// یک گروه برای هر CPU (حداکثر FS_MAX_ALLOC_GROUPS)؛ اندازه گروه مضرب 64 است
+// هزینه فقط به اندازه دیسک بستگی دارد (نه تعداد فایل‌ها)؛ کلمه‌های 64 بیتی
+// کاملاً پر یا کاملاً خالی یکجا رد می‌شوند
 void fs_init_free_list(struct fs_state *state) {
     if (!state) return;
     
-    // کل فضای دیسک را به عنوان یک بلوک خالی بزرگ در نظر بگیریم
-    uint32_t total_blocks = FS_SIZE / BLOCK_SIZE;
-    uint32_t used_blocks = state->superblock->last_used_byte / BLOCK_SIZE;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t count = cpus < 1 ? 1 : cpus > FS_MAX_ALLOC_GROUPS ? FS_MAX_ALLOC_GROUPS : (uint32_t)cpus;
+    uint32_t group_blocks = ((FS_TOTAL_BLOCKS + count - 1) / count + 63) / 64 * 64;
     
-    // اگر فضای استفاده شده وجود دارد
-    if (used_blocks < total_blocks) {
-        free_block_t *initial_free = create_free_block(used_blocks, total_blocks - used_blocks);
-        if (initial_free) {
-            state->free_list = initial_free;
-            state->superblock->free_block_count = 1;
+    state->alloc_group_blocks = group_blocks;
+    state->alloc_group_count = (FS_TOTAL_BLOCKS + group_blocks - 1) / group_blocks;
+    state->alloc_next_group = 0;
+    for (uint32_t i = 0; i < state->alloc_group_count; i++) {
+        fs_alloc_group_t *group = &state->alloc_groups[i];
+        memset(group, 0, sizeof(*group));
+        pthread_mutex_init(&group->lock, NULL);
+    }
+    state->superblock->free_block_count = 0;
+    
+    // بدون bitmap (بنچمارک) همه بلوک‌ها استفاده شده فرض می‌شوند
+    if (!state->block_bitmap) return;
+    
+    const uint64_t *words = (const uint64_t *)state->block_bitmap;
+    free_block_t *last = NULL;
+    uint32_t run_start = 0;
+    int in_run = 0;
+    uint32_t block = 0;
+    
+    while (block < FS_TOTAL_BLOCKS) {
+        int used;
+        uint32_t step = 1;
+        
+        if (block % 64 == 0 && block + 64 <= FS_TOTAL_BLOCKS &&
+            (words[block / 64] == 0 || words[block / 64] == UINT64_MAX)) {
+            used = words[block / 64] != 0;
+            step = 64;
+        } else {
+            used = (state->block_bitmap[block / 8] >> (block % 8)) & 1;
         }
-    } else {
-        state->free_list = NULL;
-        state->superblock->free_block_count = 0;
+        
+        // بازه خالی در مرز گروه بسته می‌شود و گروه بعدی لیست خودش را دارد
+        int boundary = block % group_blocks == 0;
+        if (in_run && (used || boundary)) {
+            last = extent_add(state, &state->alloc_groups[group_of(state, run_start)], last,
+                              run_start, block - run_start);
+            in_run = 0;
+        }
+        if (boundary) {
+            last = NULL;
+        }
+        if (!used && !in_run) {
+            run_start = block;
+            in_run = 1;
+        }
+        block += step;
     }
-}
\ No newline at end of file
+    
+    if (in_run) {
+        extent_add(state, &state->alloc_groups[group_of(state, run_start)], last,
+                   run_start, FS_TOTAL_BLOCKS - run_start);
+    }
+}
+
+// آزادسازی حافظه همه گره‌های بلوک‌های خالی
+// گره‌های هر گروه یکجا با pool آن آزاد می‌شوند
+void fs_free_list_destroy(struct fs_state *state) {
+    for (uint32_t i = 0; i < state->alloc_group_count; i++) {
+        fs_alloc_group_t *group = &state->alloc_groups[i];
+        fs_pool_destroy(&group->pool);
+        pthread_mutex_destroy(&group->lock);
+        memset(group, 0, sizeof(*group));
+    }
+    state->alloc_group_count = 0;
+}
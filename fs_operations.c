@@ -2,31 +2,106 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <linux/falloc.h>
+
+// پنجره پیش‌تخصیص حدسی برای appendها (بلوک)
+#define FS_PREALLOC_MIN 16      // 64KB
+#define FS_PREALLOC_MAX 1024    // 4MB
 
 // پیدا کردن فایل بر اساس مسیر
 file_entry_t *fs_find_file(const char *path, struct fs_state *state) {
     if (strcmp(path, "/") == 0) {
-        static file_entry_t root_dir;
+        // هر نخ نسخه خودش را دارد تا درخواست‌های هم‌زمان روی هم ننویسند
+        static __thread file_entry_t root_dir;
         memset(&root_dir, 0, sizeof(root_dir));
-        strcpy(root_dir.name, "/");
         root_dir.type = 1;
         root_dir.permissions = 0755;
         root_dir.size = BLOCK_SIZE;
         root_dir.uid = 0;  // root
         root_dir.gid = 0;  // root group
-        root_dir.atime = root_dir.mtime = root_dir.ctime = time(NULL);
+        root_dir.atime = root_dir.mtime = root_dir.ctime = fs_now();
         return &root_dir;
     }
 
-    const char *filename = path + 1;
+    int32_t slot = fs_find_slot(path, state);
+    if (slot < 0) {
+        return NULL;
+    }
+    
+    return fs_entry(state, slot);
+}
+
+// پیدا کردن اسلات بر اساس مسیر؛ برای ریشه یا مسیر ناموجود -1
+int32_t fs_find_slot(const char *path, struct fs_state *state) {
+    uint32_t dir;
+    const char *name;
+    if (fs_lookup_parent(path, state, &dir, &name) < 0) {
+        return -1;
+    }
     
-    for (uint32_t i = 0; i < state->superblock->file_count; i++) {
-        if (strcmp(state->file_table[i].name, filename) == 0) {
-            return &state->file_table[i];
+    return fs_index_lookup(state, dir, name);
+}
+
+// پیمایش مسیر تا دایرکتوری والدِ آخرین جزء
+// dir: شناسه دایرکتوری والد، name: آخرین جزء مسیر (داخل خود path)
+int fs_lookup_parent(const char *path, struct fs_state *state, uint32_t *dir, const char **name) {
+    char component[MAX_FILENAME];
+    uint32_t current = FS_ROOT_DIR;
+    const char *p = path;
+    
+    while (*p == '/') p++;
+    
+    const char *end;
+    while ((end = strchr(p, '/')) != NULL) {
+        size_t len = end - p;
+        if (len >= MAX_FILENAME) {
+            return -ENAMETOOLONG;
         }
+        memcpy(component, p, len);
+        component[len] = '\0';
+        
+        int32_t slot = fs_index_lookup(state, current, component);
+        if (slot < 0) {
+            return -ENOENT;
+        }
+        if (fs_entry(state, slot)->type != 1) {
+            return -ENOTDIR;
+        }
+        current = slot + 1;
+        
+        p = end;
+        while (*p == '/') p++;
     }
     
-    return NULL;
+    *dir = current;
+    *name = p;
+    return 0;
+}
+
+// شناسه دایرکتوری (FS_ROOT_DIR یا اسلات + 1) برای یک مسیر
+static int fs_dir_id(const char *path, struct fs_state *state, uint32_t *dir_id) {
+    if (strcmp(path, "/") == 0) {
+        *dir_id = FS_ROOT_DIR;
+        return 0;
+    }
+    
+    uint32_t dir;
+    const char *name;
+    int res = fs_lookup_parent(path, state, &dir, &name);
+    if (res < 0) {
+        return res;
+    }
+    
+    int32_t slot = fs_index_lookup(state, dir, name);
+    if (slot < 0) {
+        return -ENOENT;
+    }
+    if (fs_entry(state, slot)->type != 1) {
+        return -ENOTDIR;
+    }
+    
+    *dir_id = slot + 1;
+    return 0;
 }
 
 // پیدا کردن کاربر بر اساس نام
@@ -129,145 +204,200 @@ int fs_check_access(const char *path, uint32_t required_perms) {
     return fs_check_permission(file, uid, gid, required_perms);
 }
 
-// ایجاد فایل جدید
-int fs_create_file(const char *path, mode_t mode, uint32_t type, struct fs_state *state) {
-    if (state->superblock->file_count >= MAX_FILES) {
-        return -ENOSPC;
+// گرفتن یک اسلات: اول از لیست اسلات‌های حذف شده، بعد از انتهای جدول
+static int32_t fs_alloc_slot(struct fs_state *state) {
+    superblock_t *sb = state->superblock;
+    uint32_t slot;
+    
+    if (sb->free_slot != 0) {
+        slot = sb->free_slot - 1;
+        sb->free_slot = fs_entry(state, slot)->next_free;
+    } else {
+        // جدول پر است: یک تکه جدید از فضای داده گرفته می‌شود
+        if (sb->slot_count >= fs_table_capacity(state)) {
+            int res = fs_table_grow(state);
+            if (res < 0) {
+                return res;
+            }
+        }
+        slot = sb->slot_count++;
     }
+    
+    memset(fs_entry(state, slot), 0, sizeof(file_entry_t));
+    sb->file_count++;
+    return slot;
+}
 
-    const char *filename = path + 1;
+// تبدیل اسلات به اسلات حذف شده و اضافه کردن آن به لیست آزاد
+// اسلات‌های دیگر جابجا نمی‌شوند، پس حذف O(1) است
+static void fs_free_slot(struct fs_state *state, uint32_t slot) {
+    superblock_t *sb = state->superblock;
+    file_entry_t *entry = fs_entry(state, slot);
+    
+    memset(entry, 0, sizeof(file_entry_t));
+    fs_entry_name(state, slot)[0] = '\0';
+    entry->type = FS_TYPE_FREE;
+    entry->next_free = sb->free_slot;
+    sb->free_slot = slot + 1;
+    sb->file_count--;
+}
+
+// ایجاد entry جدید با نام name در دایرکتوری dir
+// شماره اسلات جدید یا کد خطا برمی‌گرداند
+int fs_create_entry(struct fs_state *state, uint32_t dir, const char *filename,
+                    mode_t mode, uint32_t type) {
+    if (strlen(filename) >= MAX_FILENAME) {
+        return -ENAMETOOLONG;
+    }
     
-    if (fs_find_file(path, state) != NULL) {
+    if (fs_index_lookup(state, dir, filename) >= 0) {
         return -EEXIST;
     }
 
-    file_entry_t *entry = &state->file_table[state->superblock->file_count];
-    
-    strncpy(entry->name, filename, MAX_FILENAME - 1);
-    entry->name[MAX_FILENAME - 1] = '\0';
+    int32_t new_slot = fs_alloc_slot(state);
+    if (new_slot < 0) {
+        return new_slot;
+    }
+    uint32_t slot = new_slot;
+    file_entry_t *entry = fs_entry(state, slot);
+    char *entry_name = fs_entry_name(state, slot);
+    
+    strncpy(entry_name, filename, MAX_FILENAME - 1);
+    entry_name[MAX_FILENAME - 1] = '\0';
+    entry->parent = dir;
+    entry->generation = ++state->superblock->generation;
     entry->type = type;
     entry->permissions = mode & 0777;
     entry->size = 0;
     entry->uid = getuid();  // مالک فعلی
     entry->gid = getgid();  // گروه فعلی
-    entry->uid = entry->uid;
-    entry->gid = entry->gid;
-    entry->atime = entry->mtime = entry->ctime = time(NULL);
+    entry->atime = entry->mtime = entry->ctime = fs_now();
     
     // اگر فایل معمولی است، فضایی برای آن اختصاص می‌دهیم
     if (type == 0) {
         // فایل‌های معمولی حداقل یک بلوک نیاز دارند
-        uint32_t start_block;
-        if (fs_alloc_blocks(1, state, &start_block) < 0) {
+        if (fs_extent_grow(state, entry, 1) < 0) {
+            fs_free_slot(state, slot);
             return -ENOSPC;
         }
-        entry->data_offset = start_block * BLOCK_SIZE;
-        entry->data_blocks = 1;
     } else {
         // دایرکتوری‌ها فضای داده ندارند
         entry->data_offset = 0;
         entry->data_blocks = 0;
     }
     
-    state->superblock->file_count++;
+    if (fs_index_insert(state, slot) < 0) {
+        fs_extent_truncate(state, entry, 0);
+        fs_free_slot(state, slot);
+        return -ENOMEM;
+    }
     
-    printf("Created new %s: %s (UID: %u, GID: %u, Perm: %o)\n", 
-           (type == 1) ? "directory" : "file", 
-           filename, entry->uid, entry->gid, entry->permissions);
-    return 0;
+    fs_log_debug("Created new %s: %s (UID: %u, GID: %u, Perm: %o)",
+                 (type == 1) ? "directory" : "file", 
+                 filename, entry->uid, entry->gid, entry->permissions);
+    return slot;
 }
 
-// تغییر سایز فایل
-int fs_resize_file(file_entry_t *entry, uint32_t new_size, struct fs_state *state) {
-    if (!entry || !state) return -EINVAL;
-    
-    uint32_t old_blocks = entry->data_blocks;
-    uint32_t new_blocks = (new_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
-    
-    printf("Resizing file from %u to %u bytes (%u to %u blocks)\n", 
-           entry->size, new_size, old_blocks, new_blocks);
-    
-    if (new_blocks == old_blocks) {
-        entry->size = new_size;
-        entry->mtime = time(NULL);
-        return 0;
+// ایجاد فایل جدید
+int fs_create_file(const char *path, mode_t mode, uint32_t type, struct fs_state *state) {
+    uint32_t dir;
+    const char *filename;
+    int res = fs_lookup_parent(path, state, &dir, &filename);
+    if (res < 0) {
+        return res;
     }
     
-    if (new_blocks > old_blocks) {
-        // نیاز به بلوک‌های بیشتر
-        uint32_t additional_blocks = new_blocks - old_blocks;
-        uint32_t start_block;
+    res = fs_create_entry(state, dir, filename, mode, type);
+    return res < 0 ? res : 0;
+}
+
+// حذف entry با نام name از دایرکتوری dir
+// is_dir: صفر برای unlink و یک برای rmdir
+int fs_remove_entry(struct fs_state *state, uint32_t dir, const char *name, int is_dir) {
+    int32_t found = fs_index_lookup(state, dir, name);
+    if (found < 0) {
+        return -ENOENT;
+    }
+    uint32_t i = found;
+    file_entry_t *entry = fs_entry(state, i);
+    
+    // handleهای باز بدون ns_lock کار می‌کنند؛ منتظر تمام شدن آن‌ها می‌مانیم
+    // و خواننده‌های بدون قفل با تغییر seq اسلات دوباره تلاش می‌کنند
+    int res = 0;
+    fs_slot_wrlock(state, i);
+    
+    if (!is_dir && entry->type == 1) {
+        res = -EISDIR;
+    } else if (is_dir && entry->type != 1) {
+        res = -ENOTDIR;
+    } else if (is_dir && fs_index_child_count(state, i + 1) > 0) {
+        // بررسی می‌کنیم که دایرکتوری خالی باشد
+        res = -ENOTEMPTY;
+    } else if (fs_check_permission(entry, getuid(), getgid(), 2) < 0) {
+        // بررسی دسترسی حذف
+        res = -EACCES;
+    } else {
+        fs_index_remove(state, i);
         
-        // سعی می‌کنیم بلوک‌های مجاور اختصاص دهیم
-        if (fs_alloc_blocks(additional_blocks, state, &start_block) < 0) {
-            // اگر موفق نشدیم، کل فضای جدید را اختصاص می‌دهیم
-            if (fs_alloc_blocks(new_blocks, state, &start_block) < 0) {
-                return -ENOSPC;
-            }
-            
-            // بلوک‌های قدیمی را آزاد می‌کنیم
-            if (old_blocks > 0) {
-                uint32_t old_start_block = entry->data_offset / BLOCK_SIZE;
-                fs_free_blocks(old_start_block, old_blocks, state);
-            }
-            
-            entry->data_offset = start_block * BLOCK_SIZE;
+        if (fs_icache_detach(state, i)) {
+            // فایل هنوز باز است یا کرنل به آن ارجاع دارد: entry و بلوک‌ها تا
+            // آخرین fs_inode_put می‌مانند. نام پاک می‌شود تا اگر قبل از آن
+            // برنامه بسته شد، fs_reclaim_orphans در mount بعدی آزادش کند
+            fs_entry_name(state, i)[0] = '\0';
         } else {
-            // اگر بلوک‌های اختصاص داده شده مجاور نباشند، نیاز به جابجایی داده داریم
-            uint32_t new_start_block = start_block;
-            if (new_start_block != (entry->data_offset / BLOCK_SIZE) + old_blocks) {
-                // نیاز به کپی داده
-                char *old_data = (char *)state->data + entry->data_offset;
-                char *new_data = (char *)state->data + (new_start_block * BLOCK_SIZE);
-                
-                // کپی داده قدیمی
-                memcpy(new_data, old_data, entry->size);
-                
-                // آزادسازی بلوک‌های قدیمی
-                uint32_t old_start_block = entry->data_offset / BLOCK_SIZE;
-                fs_free_blocks(old_start_block, old_blocks, state);
-                
-                entry->data_offset = new_start_block * BLOCK_SIZE;
-            }
+            // آزادسازی بلوک‌های فایل
+            fs_extent_truncate(state, entry, 0);
+            fs_free_slot(state, i);
         }
-    } else {
-        // آزادسازی بلوک‌های اضافی
-        uint32_t blocks_to_free = old_blocks - new_blocks;
-        uint32_t start_block_to_free = (entry->data_offset / BLOCK_SIZE) + new_blocks;
-        
-        fs_free_blocks(start_block_to_free, blocks_to_free, state);
     }
     
-    entry->size = new_size;
-    entry->data_blocks = new_blocks;
-    entry->mtime = time(NULL);
-    
-    return 0;
+    fs_slot_unlock(state, i);
+    return res;
 }
 
-// ==================== توابع FUSE ====================
-
-int fs_getattr(const char *path, struct stat *stbuf, struct fuse_file_info *fi) {
-    (void) fi;
+// آزادسازی entry حذف شده بعد از رفتن آخرین ارجاع (fs_inode_put)
+// صدا زننده نباید ns_lock یا قفل اسلاتی را نگه داشته باشد
+void fs_remove_orphan(struct fs_state *state, uint32_t slot) {
+    fs_ns_wrlock(state);
+    fs_slot_wrlock(state, slot);
     
-    struct fs_state *state = get_fs_state();
-    if (!state) return -EIO;
+    fs_extent_truncate(state, fs_entry(state, slot), 0);
+    fs_free_slot(state, slot);
     
-    memset(stbuf, 0, sizeof(struct stat));
+    fs_slot_unlock(state, slot);
+    fs_ns_unlock(state);
+}
+
+// entryهای حذف شده‌ای که هنگام بسته شدن برنامه هنوز باز بودند (هنگام mount)
+void fs_reclaim_orphans(struct fs_state *state) {
+    uint32_t count = 0;
     
-    file_entry_t *entry = fs_find_file(path, state);
-    if (entry == NULL) {
-        return -ENOENT;
+    for (uint32_t i = 0; i < state->superblock->slot_count; i++) {
+        file_entry_t *entry = fs_entry(state, i);
+        if (entry->type == FS_TYPE_FREE || fs_entry_name(state, i)[0] != '\0') continue;
+        
+        fs_extent_truncate(state, entry, 0);
+        fs_free_slot(state, i);
+        count++;
+    }
+    
+    if (count > 0) {
+        fs_log_info("Reclaimed %u unlinked files that were still open", count);
     }
+}
+
+// پر کردن struct stat از روی entry
+void fs_fill_stat(file_entry_t *entry, struct stat *stbuf) {
+    memset(stbuf, 0, sizeof(struct stat));
     
     stbuf->st_uid = entry->uid;
     stbuf->st_gid = entry->gid;
-    stbuf->st_atime = entry->atime;
+    stbuf->st_atime = __atomic_load_n(&entry->atime, __ATOMIC_RELAXED);  // fs_read_entry
     stbuf->st_mtime = entry->mtime;
     stbuf->st_ctime = entry->ctime;
     stbuf->st_mode = entry->permissions;
     stbuf->st_size = entry->size;
-    stbuf->st_blocks = entry->data_blocks;
+    stbuf->st_blocks = (blkcnt_t)entry->alloc_blocks * (BLOCK_SIZE / 512);
     stbuf->st_blksize = BLOCK_SIZE;
     stbuf->st_nlink = 1;
     
@@ -277,253 +407,914 @@ int fs_getattr(const char *path, struct stat *stbuf, struct fuse_file_info *fi)
     } else {
         stbuf->st_mode |= S_IFREG;
     }
-    
-    return 0;
 }
 
-int fs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
-               off_t offset, struct fuse_file_info *fi, enum fuse_readdir_flags flags) {
-    (void) offset;
-    (void) fi;
-    (void) flags;
-
-    struct fs_state *state = get_fs_state();
-    if (!state) return -EIO;
-
-    // بررسی دسترسی خواندن دایرکتوری
-    if (fs_check_access(path, 4) < 0) {  // 4 = خواندن
-        return -EACCES;
+// خواندن از داده‌های entry (بدون بررسی دسترسی)؛ inode حافظه handle، اگر هست،
+// برای lazytime است
+int fs_read_entry(struct fs_state *state, file_entry_t *entry, fs_inode_t *inode,
+                  char *buf, size_t size, off_t offset) {
+    if (offset >= entry->size) {
+        return 0;
     }
-
-    filler(buf, ".", NULL, 0, 0);
-    filler(buf, "..", NULL, 0, 0);
-
-    if (strcmp(path, "/") == 0) {
-        for (uint32_t i = 0; i < state->superblock->file_count; i++) {
-            filler(buf, state->file_table[i].name, NULL, 0, 0);
-        }
+    
+    if (offset + size > entry->size) {
+        size = entry->size - offset;
     }
     
-    return 0;
+    int res = fs_extent_read(state, entry, buf, size, offset);
+    if (res < 0) {
+        return res;
+    }
+    
+    fs_touch_atime(state, entry, inode);
+    return size;
 }
 
-int fs_open(const char *path, struct fuse_file_info *fi) {
-    struct fs_state *state = get_fs_state();
-    if (!state) return -EIO;
-    
-    file_entry_t *entry = fs_find_file(path, state);
-    if (entry == NULL) {
-        return -ENOENT;
+// خواندن از داده‌های entry به صورت fuse_bufvec (بدون بررسی دسترسی)
+// با use_fd بافرها به فایل image اشاره می‌کنند و libfuse داده را با splice
+// مستقیم به کرنل می‌فرستد؛ در غیر این صورت (یا وقتی محدوده حفره دارد یا
+// داده در کش بافر دستگاه بلوکی است) داده
+// در یک بافر حافظه کپی می‌شود. بافرها با malloc گرفته شده‌اند و گیرنده آزاد می‌کند
+int fs_read_entry_buf(struct fs_state *state, file_entry_t *entry, fs_inode_t *inode, size_t size,
+                      off_t offset, int use_fd, struct fuse_bufvec **out) {
+    if (offset >= entry->size) {
+        size = 0;
+    } else if (offset + size > entry->size) {
+        size = entry->size - offset;
     }
     
-    if (entry->type == 1 && (fi->flags & O_ACCMODE) != O_RDONLY) {
-        return -EISDIR;
+    if (use_fd && size > 0 && fs_bdev_splice(state) && fs_extent_bufvec(state, entry, size, offset, out) == 0) {
+        fs_touch_atime(state, entry, inode);
+        return size;
     }
     
-    // بررسی دسترسی بر اساس نوع عملیات
-    uint32_t required_perms = 0;
-    int accmode = fi->flags & O_ACCMODE;
-    
-    if (accmode == O_RDONLY) {
-        required_perms = 4;  // خواندن
-    } else if (accmode == O_WRONLY || accmode == O_RDWR) {
-        required_perms = 2;  // نوشتن
+    struct fuse_bufvec *bufv = malloc(sizeof(struct fuse_bufvec));
+    char *buf = malloc(size ? size : 1);
+    if (!bufv || !buf) {
+        free(bufv);
+        free(buf);
+        return -ENOMEM;
     }
     
-    if (fs_check_permission(entry, getuid(), getgid(), required_perms) < 0) {
-        return -EACCES;
+    int res = fs_read_entry(state, entry, inode, buf, size, offset);
+    if (res < 0) {
+        free(bufv);
+        free(buf);
+        return res;
     }
-    
-    entry->atime = time(NULL);
-    return 0;
+    *bufv = FUSE_BUFVEC_INIT(res);
+    bufv->buf[0].mem = buf;
+    *out = bufv;
+    return res;
 }
 
-int fs_read(const char *path, char *buf, size_t size, off_t offset,
-            struct fuse_file_info *fi) {
-    (void) fi;
+// آماده کردن [offset, offset + size) برای نوشتن: حفره‌ها پر، فایل بزرگ و
+// فاصله تا offset صفر می‌شود؛ بعد از آن محدوده بدون حفره روی دیسک است.
+// یک اگر اندازه یا بلوک‌های entry تغییر کرد. اندازه entry 32 بیتی است و
+// حفره‌ها جا نمی‌گیرند، پس انتهای بعد از 4 گیگ -EFBIG است نه ENOSPC
+static int fs_write_prepare(struct fs_state *state, file_entry_t *entry, size_t size, off_t offset) {
+    if ((uint64_t)offset + size > UINT32_MAX) {
+        return -EFBIG;
+    }
     
-    struct fs_state *state = get_fs_state();
-    if (!state) return -EIO;
+    uint32_t old_size = entry->size;
+    uint32_t old_blocks = entry->data_blocks;
+    uint32_t old_alloc = entry->alloc_blocks;
+    size_t new_size = offset + size;
+    uint32_t first_block = offset / BLOCK_SIZE;
+    uint32_t new_blocks = (new_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
     
-    file_entry_t *entry = fs_find_file(path, state);
-    if (entry == NULL) {
-        return -ENOENT;
+    // بلوک‌های کامل بین انتهای نقشه و offset حفره می‌شوند (بدون تخصیص)
+    if (first_block > entry->data_blocks) {
+        int res = fs_extent_grow_hole(state, entry, first_block - entry->data_blocks);
+        if (res < 0) {
+            return res;
+        }
     }
     
-    // بررسی دسترسی خواندن
-    if (fs_check_permission(entry, getuid(), getgid(), 4) < 0) {
-        return -EACCES;
+    // حفره‌های زیر محدوده نوشتن پر می‌شوند
+    int res = fs_extent_fill(state, entry, first_block, new_blocks - first_block);
+    if (res < 0) {
+        return res;
     }
     
-    if (offset >= entry->size) {
+    // بلوک‌های پیش‌تخصیص داده شده بعد از EOF دوباره تخصیص داده نمی‌شوند
+    if (new_blocks > entry->data_blocks) {
+        res = fs_extent_grow(state, entry, new_blocks - entry->data_blocks);
+        if (res < 0) {
+            return res;
+        }
+    }
+    
+    if (new_size > entry->size) {
+        // فاصله بین انتهای قبلی و offset صفر خوانده می‌شود
+        if ((size_t)offset > entry->size) {
+            res = fs_extent_zero(state, entry, offset - entry->size, entry->size);
+            if (res < 0) {
+                return res;
+            }
+        }
+        entry->size = new_size;
+    }
+    return entry->size != old_size || entry->data_blocks != old_blocks ||
+           entry->alloc_blocks != old_alloc;
+}
+
+// نوشتن در داده‌های entry با بزرگ کردن فایل در صورت نیاز (بدون بررسی دسترسی)
+int fs_write_entry(struct fs_state *state, file_entry_t *entry, fs_inode_t *inode,
+                   const char *buf, size_t size, off_t offset) {
+    if (entry->type == 1) {
+        return -EISDIR;
+    }
+    
+    if (size == 0) {
         return 0;
     }
     
-    if (offset + size > entry->size) {
-        size = entry->size - offset;
+    uint32_t old_size = entry->size;
+    int dirty = fs_write_prepare(state, entry, size, offset);
+    if (dirty < 0) {
+        return dirty;
     }
     
-    char *data_ptr = (char *)state->data + entry->data_offset + offset;
-    memcpy(buf, data_ptr, size);
+    int res = fs_extent_write(state, entry, buf, size, offset);
+    if (res < 0) {
+        // خطای دستگاه بلوکی: انتهای فایل به قبل از این نوشتن برمی‌گردد
+        if (entry->size > old_size) {
+            fs_resize_file(entry, old_size, state);
+        }
+        return res;
+    }
     
-    entry->atime = time(NULL);
+    fs_touch_mtime(state, entry, inode, dirty);
     return size;
 }
 
-int fs_write(const char *path, const char *buf, size_t size, off_t offset,
-             struct fuse_file_info *fi) {
-    (void) fi;
-    
-    struct fs_state *state = get_fs_state();
-    if (!state) return -EIO;
-    
-    file_entry_t *entry = fs_find_file(path, state);
-    if (entry == NULL) {
-        return -ENOENT;
+// نوشتن fuse_bufvec در entry (بدون بررسی دسترسی)
+// داده‌ای که libfuse در pipe نگه داشته (splice از /dev/fuse) با fuse_buf_copy
+// مستقیم به فایل image در آفست بلوک‌ها منتقل می‌شود و از فضای کاربر رد نمی‌شود؛
+// بافر حافظه معمولی مثل قبل در mmap کپی می‌شود. با کش بافر دستگاه بلوکی
+// داده pipe اول در یک بافر خوانده و بعد مثل write نوشته می‌شود
+int fs_write_entry_buf(struct fs_state *state, file_entry_t *entry, fs_inode_t *inode,
+                       struct fuse_bufvec *src, off_t offset) {
+    size_t size = fuse_buf_size(src);
+    
+    int from_fd = 0;
+    for (size_t i = src->idx; i < src->count; i++) {
+        from_fd |= src->buf[i].flags & FUSE_BUF_IS_FD;
+    }
+    if (!from_fd && src->count - src->idx == 1) {
+        return fs_write_entry(state, entry, inode, (char *)src->buf[src->idx].mem + src->off,
+                              size, offset);
+    }
+    if (!fs_bdev_splice(state)) {
+        char *buf = malloc(size ? size : 1);
+        if (!buf) {
+            return -ENOMEM;
+        }
+        struct fuse_bufvec dst = FUSE_BUFVEC_INIT(size);
+        dst.buf[0].mem = buf;
+        ssize_t copied = fuse_buf_copy(&dst, src, 0);
+        int res = copied < 0 ? (int)copied : fs_write_entry(state, entry, inode, buf, copied, offset);
+        free(buf);
+        return res;
     }
     
     if (entry->type == 1) {
         return -EISDIR;
     }
     
-    // بررسی دسترسی نوشتن
-    if (fs_check_permission(entry, getuid(), getgid(), 2) < 0) {
-        return -EACCES;
+    if (size == 0) {
+        return 0;
     }
     
-    size_t new_size = offset + size;
-    if (new_size > entry->size) {
-        int res = fs_resize_file(entry, new_size, state);
-        if (res < 0) {
-            return res;
-        }
+    uint32_t old_size = entry->size;
+    int dirty = fs_write_prepare(state, entry, size, offset);
+    if (dirty < 0) {
+        return dirty;
     }
     
-    char *data_ptr = (char *)state->data + entry->data_offset + offset;
-    memcpy(data_ptr, buf, size);
+    struct fuse_bufvec *dst;
+    int res = fs_extent_bufvec(state, entry, size, offset, &dst);
+    ssize_t copied = res < 0 ? res : fuse_buf_copy(dst, src, 0);
+    if (res == 0) {
+        free(dst);
+    }
     
-    entry->mtime = time(NULL);
-    return size;
+    // نوشتن ناقص: انتهای فایل به آنچه واقعاً نوشته شد برمی‌گردد
+    if (copied < (ssize_t)size) {
+        uint32_t end = copied > 0 ? offset + copied : offset;
+        if (end < old_size) {
+            end = old_size;
+        }
+        if (entry->size > end) {
+            fs_resize_file(entry, end, state);
+        }
+        if (copied <= 0) {
+            return copied < 0 ? copied : -EIO;
+        }
+    }
+    
+    fs_touch_mtime(state, entry, inode, dirty || entry->size != old_size);
+    return copied;
 }
 
-int fs_create(const char *path, mode_t mode, struct fuse_file_info *fi) {
-    struct fs_state *state = get_fs_state();
-    if (!state) return -EIO;
+// سوراخ کردن [offset, end): بلوک‌های کامل آزاد و تکه‌های ابتدا و انتها صفر می‌شوند
+static int fs_punch_hole(struct fs_state *state, file_entry_t *entry, uint64_t offset, uint64_t end) {
+    uint64_t limit = (uint64_t)entry->data_blocks * BLOCK_SIZE;
+    if (end > limit) {
+        end = limit;
+    }
+    if (offset >= end) {
+        return 0;
+    }
     
-    // بررسی دسترسی ایجاد در دایرکتوری والد
-    char parent_path[1024];
-    strcpy(parent_path, path);
-    char *last_slash = strrchr(parent_path, '/');
-    if (last_slash && last_slash != parent_path) {
-        *last_slash = '\0';
-        if (strlen(parent_path) == 0) {
-            strcpy(parent_path, "/");
-        }
-        if (fs_check_access(parent_path, 2) < 0) {  // نوشتن در دایرکتوری
-            return -EACCES;
-        }
+    uint32_t first_full = (offset + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint32_t end_full = end / BLOCK_SIZE;
+    if (first_full >= end_full) {
+        return fs_extent_zero(state, entry, end - offset, offset);
     }
     
-    int res = fs_create_file(path, mode, 0, state);
+    int res = fs_extent_zero(state, entry, (uint64_t)first_full * BLOCK_SIZE - offset, offset);
+    if (res == 0) {
+        res = fs_extent_zero(state, entry, end - (uint64_t)end_full * BLOCK_SIZE, (uint64_t)end_full * BLOCK_SIZE);
+    }
     if (res < 0) {
         return res;
     }
-    
-    return fs_open(path, fi);
+    return fs_extent_punch(state, entry, first_full, end_full - first_full);
 }
 
-int fs_mkdir(const char *path, mode_t mode) {
-    struct fs_state *state = get_fs_state();
-    if (!state) return -EIO;
+// fallocate روی entry: mode صفر و FALLOC_FL_KEEP_SIZE بلوک رزرو می‌کنند و
+// FALLOC_FL_PUNCH_HOLE (همیشه همراه KEEP_SIZE) بلوک‌های محدوده را پس می‌دهد
+int fs_fallocate_entry(struct fs_state *state, file_entry_t *entry, int mode, off_t offset, off_t length) {
+    if (entry->type == 1) {
+        return -EISDIR;
+    }
+    if (mode & ~(FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE)) {
+        return -EOPNOTSUPP;
+    }
+    if (offset < 0 || length <= 0) {
+        return -EINVAL;
+    }
     
-    // بررسی دسترسی ایجاد دایرکتوری در والد
-    char parent_path[1024];
-    strcpy(parent_path, path);
-    char *last_slash = strrchr(parent_path, '/');
-    if (last_slash && last_slash != parent_path) {
-        *last_slash = '\0';
-        if (strlen(parent_path) == 0) {
-            strcpy(parent_path, "/");
+    uint64_t end = (uint64_t)offset + length;
+    
+    if (mode & FALLOC_FL_PUNCH_HOLE) {
+        if (!(mode & FALLOC_FL_KEEP_SIZE)) {
+            return -EOPNOTSUPP;
         }
-        if (fs_check_access(parent_path, 2) < 0) {  // نوشتن در دایرکتوری
-            return -EACCES;
+        int res = fs_punch_hole(state, entry, offset, end);
+        if (res == 0) {
+            entry->mtime = entry->ctime = fs_now();
         }
+        return res;
     }
     
-    return fs_create_file(path, mode | S_IFDIR, 1, state);
-}
-
-int fs_unlink(const char *path) {
-    struct fs_state *state = get_fs_state();
-    if (!state) return -EIO;
+    if (end > UINT32_MAX) {
+        return -EFBIG;
+    }
     
-    const char *filename = path + 1;
-    file_entry_t *table = state->file_table;
-    uint32_t count = state->superblock->file_count;
+    // حفره‌های داخل محدوده پر و بعد نقشه تا انتهای محدوده بزرگ می‌شود
+    uint32_t first_block = offset / BLOCK_SIZE;
+    uint32_t blocks = (end + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    int res = fs_extent_fill(state, entry, first_block, blocks - first_block);
+    if (res < 0) {
+        return res;
+    }
+    if (blocks > entry->data_blocks) {
+        res = fs_extent_grow(state, entry, blocks - entry->data_blocks);
+        if (res < 0) {
+            return res;
+        }
+    }
     
-    for (uint32_t i = 0; i < count; i++) {
-        if (strcmp(table[i].name, filename) == 0) {
-            if (table[i].type == 1) {
-                return -EISDIR;
-            }
-            
-            // بررسی دسترسی حذف
-            if (fs_check_permission(&table[i], getuid(), getgid(), 2) < 0) {
-                return -EACCES;
-            }
-            
-            // آزادسازی بلوک‌های فایل
-            if (table[i].data_blocks > 0) {
-                uint32_t start_block = table[i].data_offset / BLOCK_SIZE;
-                fs_free_blocks(start_block, table[i].data_blocks, state);
-            }
-            
-            memmove(&table[i], &table[i + 1], (count - i - 1) * sizeof(file_entry_t));
-            state->superblock->file_count--;
-            
-            printf("Deleted file: %s\n", filename);
-            return 0;
+    if (!(mode & FALLOC_FL_KEEP_SIZE) && end > entry->size) {
+        return fs_resize_file(entry, end, state);
+    }
+    return 0;
+}
+
+// پیش‌تخصیص حدسی: وقتی نوشتن در انتهای فایل بلوک جدید لازم دارد، پنجره‌ای
+// بعد از EOF هم‌اندازه خود فایل (بین FS_PREALLOC_MIN و FS_PREALLOC_MAX) هم
+// رزرو می‌شود تا appendهای بعدی بدون allocator و پشت سر هم روی دیسک بنشینند
+void fs_prealloc_append(struct fs_state *state, fs_inode_t *inode, size_t size, off_t offset) {
+    file_entry_t *entry = fs_inode_entry(state, inode);
+    if (!entry || entry->type == 1 || (uint64_t)offset != entry->size) {
+        return;
+    }
+    
+    uint64_t end = (uint64_t)offset + size;
+    uint64_t needed = (end + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (needed <= entry->data_blocks) {
+        return;
+    }
+    
+    uint32_t window = entry->data_blocks;
+    if (window < FS_PREALLOC_MIN) window = FS_PREALLOC_MIN;
+    if (window > FS_PREALLOC_MAX) window = FS_PREALLOC_MAX;
+    if (needed + window > UINT32_MAX / BLOCK_SIZE) {
+        return;
+    }
+    
+    // اگر جا نبود، خود write فقط بلوک‌های لازم را تخصیص می‌دهد
+    if (fs_extent_grow(state, entry, needed + window - entry->data_blocks) == 0) {
+        inode->prealloc_end = entry->data_blocks;
+    }
+}
+
+// برگرداندن پیش‌تخصیص حدسی استفاده نشده (هنگام بستن فایل)
+// اگر بعد از آن فایل کوتاه یا fallocate شده، بلوک‌ها دست نمی‌خورند
+void fs_prealloc_trim(struct fs_state *state, fs_inode_t *inode) {
+    file_entry_t *entry = fs_inode_entry(state, inode);
+    if (entry && inode->prealloc_end && entry->data_blocks == inode->prealloc_end) {
+        fs_extent_truncate(state, entry, (entry->size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    }
+    inode->prealloc_end = 0;
+}
+
+// تغییر سایز فایل؛ مثل fs_write_prepare بیشتر از UINT32_MAX -EFBIG است
+int fs_resize_file(file_entry_t *entry, uint64_t new_size, struct fs_state *state) {
+    if (!entry || !state) return -EINVAL;
+    if (new_size > UINT32_MAX) return -EFBIG;
+    
+    uint32_t old_blocks = entry->data_blocks;
+    uint32_t new_blocks = (new_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    
+    fs_log_debug("Resizing file from %u to %llu bytes (%u to %u blocks)",
+                 entry->size, (unsigned long long)new_size, old_blocks, new_blocks);
+    
+    if (new_blocks > old_blocks) {
+        // بزرگ کردن با truncate فقط حفره اضافه می‌کند
+        int res = fs_extent_grow_hole(state, entry, new_blocks - old_blocks);
+        if (res < 0) {
+            return res;
+        }
+    } else if (new_size < entry->size) {
+        // آزادسازی بلوک‌های اضافی (همراه با بلوک‌های رزرو شده بعد از EOF)
+        fs_extent_truncate(state, entry, new_blocks);
+    }
+    
+    // بخش اضافه شده به فایل صفر خوانده می‌شود
+    if (new_size > entry->size) {
+        int res = fs_extent_zero(state, entry, new_size - entry->size, entry->size);
+        if (res < 0) {
+            return res;
+        }
+    }
+    
+    entry->size = new_size;
+    entry->mtime = fs_now();
+    
+    return 0;
+}
+
+// ==================== توابع FUSE ====================
+
+// قفل‌های یک درخواست (locks.c): قفل اسلات فایل، و برای مسیر ns_lock اشتراکی
+// هم تا lookup معتبر بماند. handle باز ns_lock نمی‌خواهد چون اسلات تا بسته
+// شدن آن (حتی بعد از unlink) آزاد نمی‌شود. اسلات برگشتی به fs_request_unlock می‌رود
+static int32_t fs_request_lock(struct fs_state *state, const char *path,
+                               struct fuse_file_info *fi, int write) {
+    fs_handle_t *handle = fs_file_handle(fi);
+    int32_t slot;
+    
+    if (handle) {
+        slot = fs_handle_slot(handle);
+    } else {
+        fs_ns_rdlock(state);
+        slot = fs_find_slot(path, state);
+    }
+    
+    if (write) {
+        fs_slot_wrlock(state, slot);
+    } else {
+        fs_slot_rdlock(state, slot);
+    }
+    return slot;
+}
+
+static void fs_request_unlock(struct fs_state *state, struct fuse_file_info *fi, int32_t slot) {
+    fs_slot_unlock(state, slot);
+    if (!fs_file_handle(fi)) {
+        fs_ns_unlock(state);
+    }
+}
+
+// entry مسیر وقتی اسلاتش پیدا شده (ریشه اسلات ندارد)
+static file_entry_t *fs_path_entry(struct fs_state *state, const char *path, int32_t slot) {
+    if (slot >= 0) {
+        return fs_entry(state, slot);
+    }
+    return strcmp(path, "/") == 0 ? fs_find_file(path, state) : NULL;
+}
+
+// خواندن entry یک مسیر بدون قفل (locks.c): visit روی entry اجرا می‌شود و
+// نتیجه‌اش فقط اگر در این فاصله فضای نام و خود entry تغییر نکرده باشند
+// برگردانده می‌شود؛ بعد از FS_SEQ_RETRIES تلاش، زیر قفل‌ها اجرا می‌شود
+static int fs_peek_path(struct fs_state *state, const char *path,
+                        int (*visit)(file_entry_t *entry, void *arg), void *arg) {
+    for (int attempt = 0; attempt < FS_SEQ_RETRIES; attempt++) {
+        uint32_t ns_seq = fs_ns_seq_begin(state);
+        int32_t slot = fs_find_slot(path, state);
+        uint32_t seq = fs_slot_seq_begin(state, slot);
+        
+        file_entry_t *entry = fs_path_entry(state, path, slot);
+        int res = entry ? visit(entry, arg) : -ENOENT;
+        
+        if (!fs_slot_seq_retry(state, slot, seq) && !fs_ns_seq_retry(state, ns_seq)) {
+            return res;
         }
     }
     
-    return -ENOENT;
+    int32_t slot = fs_request_lock(state, path, NULL, 0);
+    file_entry_t *entry = fs_path_entry(state, path, slot);
+    int res = entry ? visit(entry, arg) : -ENOENT;
+    fs_request_unlock(state, NULL, slot);
+    return res;
 }
 
-int fs_rmdir(const char *path) {
+// inode حافظه handle (برای lazytime)، یا NULL برای عملیات بدون open
+static fs_inode_t *fs_fi_inode(struct fuse_file_info *fi) {
+    fs_handle_t *handle = fs_file_handle(fi);
+    return handle ? handle->inode : NULL;
+}
+
+static int fs_stat_visit(file_entry_t *entry, void *arg) {
+    fs_fill_stat(entry, arg);
+    return 0;
+}
+
+int fs_getattr(const char *path, struct stat *stbuf, struct fuse_file_info *fi) {
     struct fs_state *state = get_fs_state();
     if (!state) return -EIO;
     
-    const char *dirname = path + 1;
-    file_entry_t *table = state->file_table;
-    uint32_t count = state->superblock->file_count;
-    
-    // بررسی می‌کنیم که دایرکتوری خالی باشد
-    // (در نسخه ساده، همه فایل‌ها در ریشه هستند)
-    for (uint32_t i = 0; i < count; i++) {
-        if (strcmp(table[i].name, dirname) == 0 && table[i].type == 1) {
-            
-            // بررسی دسترسی حذف
-            if (fs_check_permission(&table[i], getuid(), getgid(), 2) < 0) {
-                return -EACCES;
-            }
-            
-            memmove(&table[i], &table[i + 1], (count - i - 1) * sizeof(file_entry_t));
-            state->superblock->file_count--;
-            
-            printf("Deleted directory: %s\n", dirname);
-            return 0;
+    int res = fs_peek_path(state, path, fs_stat_visit, stbuf);
+    
+    // fstat روی handle باز زمان‌های معوق lazytime را هم می‌بیند
+    fs_inode_t *inode = fs_fi_inode(fi);
+    if (res == 0 && inode) {
+        fs_lazytime_stat(inode, stbuf);
+    }
+    return res;
+}
+
+static int fs_readdir_locked(struct fs_state *state, const char *path, void *buf,
+                             fuse_fill_dir_t filler, enum fuse_readdir_flags flags) {
+    uint32_t dir;
+    int res = fs_dir_id(path, state, &dir);
+    if (res < 0) {
+        return res;
+    }
+    
+    // بررسی دسترسی خواندن دایرکتوری
+    if (fs_check_access(path, 4) < 0) {  // 4 = خواندن
+        return -EACCES;
+    }
+
+    // در حالت readdirplus، stat هر entry همین‌جا پر می‌شود تا کرنل
+    // برای هر فایل یک getattr جداگانه نفرستد
+    int plus = (flags & FUSE_READDIR_PLUS) != 0;
+    enum fuse_fill_dir_flags fill_flags = plus ? FUSE_FILL_DIR_PLUS : 0;
+    struct stat st;
+
+    if (plus) {
+        fs_fill_stat(fs_find_file(path, state), &st);
+    }
+    filler(buf, ".", plus ? &st : NULL, 0, fill_flags);
+    filler(buf, "..", NULL, 0, 0);
+
+    // فقط فرزندان همین دایرکتوری را پیمایش می‌کنیم
+    for (int32_t i = fs_index_first_child(state, dir); i >= 0;
+         i = fs_index_next_child(state, i)) {
+        if (plus) {
+            fs_slot_rdlock(state, i);
+            fs_fill_stat(fs_entry(state, i), &st);
+            fs_slot_unlock(state, i);
         }
+        filler(buf, fs_entry_name(state, i), plus ? &st : NULL, 0, fill_flags);
     }
     
-    return -ENOENT;
+    return 0;
 }
 
-int fs_truncate(const char *path, off_t size, struct fuse_file_info *fi) {
+int fs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
+               off_t offset, struct fuse_file_info *fi, enum fuse_readdir_flags flags) {
+    (void) offset;
     (void) fi;
     
     struct fs_state *state = get_fs_state();
     if (!state) return -EIO;
     
+    // نام‌ها و ترتیب فرزندان زیر ns_lock ثابت می‌مانند
+    int32_t slot = fs_request_lock(state, path, NULL, 0);
+    int res = fs_readdir_locked(state, path, buf, filler, flags);
+    fs_request_unlock(state, NULL, slot);
+    return res;
+}
+
+// بررسی اینکه entry با پرچم‌های flags قابل باز شدن است
+int fs_open_entry(file_entry_t *entry, int flags) {
+    if (entry->type == 1 && (flags & O_ACCMODE) != O_RDONLY) {
+        return -EISDIR;
+    }
+    
+    // بررسی دسترسی بر اساس نوع عملیات
+    uint32_t required_perms = 0;
+    int accmode = flags & O_ACCMODE;
+    
+    if (accmode == O_RDONLY) {
+        required_perms = 4;  // خواندن
+    } else if (accmode == O_WRONLY || accmode == O_RDWR) {
+        required_perms = 2;  // نوشتن
+    }
+    
+    if (fs_check_permission(entry, getuid(), getgid(), required_perms) < 0) {
+        return -EACCES;
+    }
+    return 0;
+}
+
+static int fs_open_locked(struct fs_state *state, const char *path, struct fuse_file_info *fi) {
+    // ریشه اسلات ندارد؛ بدون handle باز می‌شود
+    if (strcmp(path, "/") == 0) {
+        fi->fh = 0;
+        return fs_open_entry(fs_find_file(path, state), fi->flags);
+    }
+    
+    int32_t slot = fs_find_slot(path, state);
+    if (slot < 0) {
+        return -ENOENT;
+    }
+    
+    // lookup و بررسی دسترسی فقط یک بار، همین‌جا
+    fs_handle_t *handle;
+    int res = fs_handle_open(state, slot, fi->flags, &handle);
+    if (res < 0) {
+        return res;
+    }
+    
+    fi->fh = (uintptr_t)handle;
+    return 0;
+}
+
+int fs_open(const char *path, struct fuse_file_info *fi) {
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
+    int32_t slot = fs_request_lock(state, path, NULL, 0);
+    int res = fs_open_locked(state, path, fi);
+    fs_request_unlock(state, NULL, slot);
+    return res;
+}
+
+// entry فایلی که خوانده می‌شود، بعد از بررسی دسترسی خواندن
+static int fs_read_target(struct fs_state *state, const char *path, struct fuse_file_info *fi,
+                          file_entry_t **out) {
+    // مسیر سریع: entry و دسترسی در fs_open مشخص شده‌اند
+    fs_handle_t *handle = fs_file_handle(fi);
+    if (handle) {
+        *out = fs_inode_entry(state, handle->inode);
+        if (*out == NULL) {
+            return -ENOENT;
+        }
+        return handle->can_read ? 0 : -EACCES;
+    }
+    
+    *out = fs_find_file(path, state);
+    if (*out == NULL) {
+        return -ENOENT;
+    }
+    
+    // بررسی دسترسی خواندن
+    if (fs_check_permission(*out, getuid(), getgid(), 4) < 0) {
+        return -EACCES;
+    }
+    return 0;
+}
+
+static int fs_read_locked(struct fs_state *state, const char *path, char *buf, size_t size,
+                          off_t offset, struct fuse_file_info *fi) {
+    file_entry_t *entry;
+    int res = fs_read_target(state, path, fi, &entry);
+    if (res < 0) {
+        return res;
+    }
+    return fs_read_entry(state, entry, fs_fi_inode(fi), buf, size, offset);
+}
+
+int fs_read(const char *path, char *buf, size_t size, off_t offset,
+            struct fuse_file_info *fi) {
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
+    int32_t slot = fs_request_lock(state, path, fi, 0);
+    int res = fs_read_locked(state, path, buf, size, offset, fi);
+    fs_request_unlock(state, fi, slot);
+    return res;
+}
+
+// read_buf: libfuse داده را بعد از برگشتن این تابع (و رها شدن قفل اسلات) از
+// بافرها می‌خواند. با حلقه چندنخی ممکن است در این فاصله truncate هم‌زمان بلوک‌ها
+// را آزاد کند و فایل دیگری روی آن‌ها بنویسد، پس splice از image فقط با -s است
+// و در غیر این صورت داده زیر قفل کپی می‌شود (frontend سطح پایین همیشه زیر قفل
+// پاسخ می‌دهد)
+int fs_read_buf(const char *path, struct fuse_bufvec **bufp, size_t size, off_t offset,
+                struct fuse_file_info *fi) {
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
+    int32_t slot = fs_request_lock(state, path, fi, 0);
+    file_entry_t *entry;
+    int res = fs_read_target(state, path, fi, &entry);
+    if (res == 0) {
+        int use_fd = state->singlethread && !state->copy_read;
+        res = fs_read_entry_buf(state, entry, fs_fi_inode(fi), size, offset, use_fd, bufp);
+    }
+    fs_request_unlock(state, fi, slot);
+    return res < 0 ? res : 0;
+}
+
+// entry فایلی که نوشته می‌شود، بعد از بررسی دسترسی نوشتن
+// (با handle پیش‌تخصیص نوشتن ترتیبی هم همین‌جا انجام می‌شود)
+static int fs_write_target(struct fs_state *state, const char *path, size_t size, off_t offset,
+                           struct fuse_file_info *fi, file_entry_t **out) {
+    // مسیر سریع: entry و دسترسی در fs_open مشخص شده‌اند
+    fs_handle_t *handle = fs_file_handle(fi);
+    if (handle) {
+        *out = fs_inode_entry(state, handle->inode);
+        if (*out == NULL) {
+            return -ENOENT;
+        }
+        if (!handle->can_write) {
+            return -EACCES;
+        }
+        fs_prealloc_append(state, handle->inode, size, offset);
+        return 0;
+    }
+    
+    *out = fs_find_file(path, state);
+    if (*out == NULL) {
+        return -ENOENT;
+    }
+    
+    if ((*out)->type == 1) {
+        return -EISDIR;
+    }
+    
+    // بررسی دسترسی نوشتن
+    if (fs_check_permission(*out, getuid(), getgid(), 2) < 0) {
+        return -EACCES;
+    }
+    return 0;
+}
+
+static int fs_write_locked(struct fs_state *state, const char *path, const char *buf, size_t size,
+                           off_t offset, struct fuse_file_info *fi) {
+    file_entry_t *entry;
+    int res = fs_write_target(state, path, size, offset, fi, &entry);
+    if (res < 0) {
+        return res;
+    }
+    return fs_write_entry(state, entry, fs_fi_inode(fi), buf, size, offset);
+}
+
+int fs_write(const char *path, const char *buf, size_t size, off_t offset,
+             struct fuse_file_info *fi) {
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
+    int32_t slot = fs_request_lock(state, path, fi, 1);
+    int res = fs_write_locked(state, path, buf, size, offset, fi);
+    fs_request_unlock(state, fi, slot);
+    return res;
+}
+
+// write_buf: داده درخواست (اگر libfuse آن را در pipe نگه داشته) با splice
+// مستقیم به فایل image می‌رود؛ کپی قبل از برگشتن و زیر قفل اسلات انجام می‌شود
+int fs_write_buf(const char *path, struct fuse_bufvec *buf, off_t offset,
+                 struct fuse_file_info *fi) {
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
+    int32_t slot = fs_request_lock(state, path, fi, 1);
+    file_entry_t *entry;
+    int res = fs_write_target(state, path, fuse_buf_size(buf), offset, fi, &entry);
+    if (res == 0) {
+        res = fs_write_entry_buf(state, entry, fs_fi_inode(fi), buf, offset);
+    }
+    fs_request_unlock(state, fi, slot);
+    return res;
+}
+
+static int fs_create_locked(struct fs_state *state, const char *path, mode_t mode,
+                            struct fuse_file_info *fi) {
+    // بررسی دسترسی ایجاد در دایرکتوری والد
+    char parent_path[1024];
+    strcpy(parent_path, path);
+    char *last_slash = strrchr(parent_path, '/');
+    if (last_slash && last_slash != parent_path) {
+        *last_slash = '\0';
+        if (strlen(parent_path) == 0) {
+            strcpy(parent_path, "/");
+        }
+        int access_res = fs_check_access(parent_path, 2);  // نوشتن در دایرکتوری
+        if (access_res < 0) {
+            return access_res;
+        }
+    }
+    
+    uint32_t dir;
+    const char *filename;
+    int res = fs_lookup_parent(path, state, &dir, &filename);
+    if (res < 0) {
+        return res;
+    }
+    
+    int slot = fs_create_entry(state, dir, filename, mode, 0);
+    if (slot < 0) {
+        return slot;
+    }
+    
+    fs_handle_t *handle;
+    res = fs_handle_open(state, slot, fi->flags, &handle);
+    if (res < 0) {
+        return res;
+    }
+    
+    fi->fh = (uintptr_t)handle;
+    return 0;
+}
+
+// ساخت و حذف نام‌ها ns_lock را انحصاری می‌گیرند
+int fs_create(const char *path, mode_t mode, struct fuse_file_info *fi) {
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
+    fs_ns_wrlock(state);
+    int res = fs_create_locked(state, path, mode, fi);
+    fs_ns_unlock(state);
+    return res;
+}
+
+int fs_release(const char *path, struct fuse_file_info *fi) {
+    (void) path;
+    
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
+    // release نوشتنی پیش‌تخصیص را پس می‌دهد و شاید فایل را defrag کند
+    // ارجاع handle بعد از آزاد کردن قفل پس داده می‌شود، چون آخرین ارجاع
+    // فایل حذف شده ns_lock و قفل اسلات را برای آزادسازی آن می‌گیرد
+    fs_handle_t *handle = fs_file_handle(fi);
+    int32_t slot = fs_handle_slot(handle);
+    fs_slot_wrlock(state, slot);
+    fs_inode_t *inode = fs_handle_release(state, handle);
+    fs_slot_unlock(state, slot);
+    fs_inode_put(state, inode, 1);
+    
+    fi->fh = 0;
+    return 0;
+}
+
+// flush (هر close روی fd): بلوک‌های کثیف همین فایل در کش بافر pio روی فایل
+// image نوشته می‌شوند و خطای نوشتن به close برمی‌گردد
+int fs_flush(const char *path, struct fuse_file_info *fi) {
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
+    int32_t slot = fs_request_lock(state, path, fi, 0);
+    fs_handle_t *handle = fs_file_handle(fi);
+    file_entry_t *entry = handle ? fs_inode_entry(state, handle->inode) : fs_find_file(path, state);
+    int res = entry ? fs_extent_flush(state, entry) : -ENOENT;
+    fs_request_unlock(state, fi, slot);
+    
+    return res;
+}
+
+// fsync: مثل flush و بعد داده image روی دیسک (بدون قفل اسلات)
+int fs_fsync(const char *path, int datasync, struct fuse_file_info *fi) {
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
+    int res = fs_flush(path, fi);
+    if (res < 0) {
+        return res;
+    }
+    return fs_bdev_sync(state, datasync);
+}
+
+// اعمال تنظیمات کش کرنل هنگام mount
+void *fs_init(struct fuse_conn_info *conn, struct fuse_config *cfg) {
+    struct fs_state *state = get_fs_state();
+    
+    // بافرهای fd در read_buf با splice از image به /dev/fuse می‌روند و
+    // داده write_buf با splice از /dev/fuse در pipe می‌ماند
+    if (conn->capable & FUSE_CAP_SPLICE_WRITE) {
+        conn->want |= FUSE_CAP_SPLICE_WRITE;
+    }
+    if (!state->copy_write && (conn->capable & FUSE_CAP_SPLICE_READ)) {
+        conn->want |= FUSE_CAP_SPLICE_READ;
+    }
+    
+    cfg->entry_timeout = state->cache.entry_timeout;
+    cfg->attr_timeout = state->cache.attr_timeout;
+    cfg->negative_timeout = state->cache.negative_timeout;
+    cfg->kernel_cache = state->cache.kernel_cache;
+    cfg->auto_cache = state->cache.auto_cache;
+    
+    // workerهای پانچ و لاگ در پروسه نهایی ساخته می‌شوند (threadها از fork در daemonize رد نمی‌شوند)
+    fs_log_start();
+    fs_discard_start(state);
+    
+    fs_log_info("Kernel cache: entry=%.1fs attr=%.1fs negative=%.1fs%s%s",
+                cfg->entry_timeout, cfg->attr_timeout, cfg->negative_timeout,
+                cfg->kernel_cache ? " kernel_cache" : "",
+                cfg->auto_cache ? " auto_cache" : "");
+    return state;
+}
+
+int fs_mkdir(const char *path, mode_t mode) {
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
+    int res = 0;
+    fs_ns_wrlock(state);
+    
+    // بررسی دسترسی ایجاد دایرکتوری در والد
+    char parent_path[1024];
+    strcpy(parent_path, path);
+    char *last_slash = strrchr(parent_path, '/');
+    if (last_slash && last_slash != parent_path) {
+        *last_slash = '\0';
+        if (strlen(parent_path) == 0) {
+            strcpy(parent_path, "/");
+        }
+        res = fs_check_access(parent_path, 2);  // نوشتن در دایرکتوری
+    }
+    
+    if (res == 0) {
+        res = fs_create_file(path, mode | S_IFDIR, 1, state);
+    }
+    fs_ns_unlock(state);
+    return res;
+}
+
+int fs_unlink(const char *path) {
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
+    uint32_t dir;
+    const char *filename;
+    fs_ns_wrlock(state);
+    int res = fs_lookup_parent(path, state, &dir, &filename);
+    if (res == 0) {
+        res = fs_remove_entry(state, dir, filename, 0);
+    }
+    fs_ns_unlock(state);
+    if (res < 0) {
+        return res;
+    }
+    
+    fs_log_debug("Deleted file: %s", path);
+    return 0;
+}
+
+int fs_rmdir(const char *path) {
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
+    uint32_t dir;
+    const char *dirname;
+    fs_ns_wrlock(state);
+    int res = fs_lookup_parent(path, state, &dir, &dirname);
+    if (res == 0) {
+        res = fs_remove_entry(state, dir, dirname, 1);
+    }
+    fs_ns_unlock(state);
+    if (res < 0) {
+        return res;
+    }
+    
+    fs_log_debug("Deleted directory: %s", path);
+    return 0;
+}
+
+static int fs_truncate_locked(struct fs_state *state, const char *path, off_t size,
+                              struct fuse_file_info *fi) {
+    // ftruncate روی handle باز
+    fs_handle_t *handle = fs_file_handle(fi);
+    if (handle) {
+        file_entry_t *entry = fs_inode_entry(state, handle->inode);
+        if (entry == NULL) {
+            return -ENOENT;
+        }
+        if (!handle->can_write) {
+            return -EACCES;
+        }
+        return fs_resize_file(entry, size, state);
+    }
+    
     file_entry_t *entry = fs_find_file(path, state);
     if (entry == NULL) {
         return -ENOENT;
@@ -541,40 +1332,123 @@ int fs_truncate(const char *path, off_t size, struct fuse_file_info *fi) {
     return fs_resize_file(entry, size, state);
 }
 
-int fs_utimens(const char *path, const struct timespec tv[2], struct fuse_file_info *fi) {
-    (void) fi;
-    
+int fs_truncate(const char *path, off_t size, struct fuse_file_info *fi) {
     struct fs_state *state = get_fs_state();
     if (!state) return -EIO;
     
+    int32_t slot = fs_request_lock(state, path, fi, 1);
+    int res = fs_truncate_locked(state, path, size, fi);
+    fs_request_unlock(state, fi, slot);
+    return res;
+}
+
+static int fs_fallocate_locked(struct fs_state *state, const char *path, int mode, off_t offset,
+                               off_t length, struct fuse_file_info *fi) {
+    fs_handle_t *handle = fs_file_handle(fi);
+    if (handle) {
+        file_entry_t *entry = fs_inode_entry(state, handle->inode);
+        if (entry == NULL) {
+            return -ENOENT;
+        }
+        if (!handle->can_write) {
+            return -EBADF;
+        }
+        // بلوک‌های درخواست شده دیگر حدسی نیستند
+        handle->inode->prealloc_end = 0;
+        return fs_fallocate_entry(state, entry, mode, offset, length);
+    }
+    
     file_entry_t *entry = fs_find_file(path, state);
     if (entry == NULL) {
         return -ENOENT;
     }
     
-    // فقط مالک یا root می‌تواند زمان فایل را تغییر دهد
-    uint32_t uid = getuid();
-    if (uid != entry->uid && uid != 0) {
-        return -EPERM;
+    if (fs_check_permission(entry, getuid(), getgid(), 2) < 0) {
+        return -EACCES;
     }
     
-    entry->atime = tv[0].tv_sec;
-    entry->mtime = tv[1].tv_sec;
+    return fs_fallocate_entry(state, entry, mode, offset, length);
+}
+
+// fallocate: فقط mode صفر و FALLOC_FL_KEEP_SIZE
+int fs_fallocate(const char *path, int mode, off_t offset, off_t length,
+                 struct fuse_file_info *fi) {
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
     
-    return 0;
+    int32_t slot = fs_request_lock(state, path, fi, 1);
+    int res = fs_fallocate_locked(state, path, mode, offset, length, fi);
+    fs_request_unlock(state, fi, slot);
+    return res;
 }
 
-int fs_access(const char *path, int mask) {
+// lseek: کرنل فقط SEEK_DATA و SEEK_HOLE را به فایل سیستم می‌فرستد
+off_t fs_lseek(const char *path, off_t offset, int whence, struct fuse_file_info *fi) {
     struct fs_state *state = get_fs_state();
     if (!state) return -EIO;
     
-    file_entry_t *file = fs_find_file(path, state);
-    if (!file) {
-        return -ENOENT;
+    if (whence != SEEK_DATA && whence != SEEK_HOLE) {
+        return -EINVAL;
     }
     
+    off_t res;
+    int32_t slot = fs_request_lock(state, path, fi, 0);
+    fs_handle_t *handle = fs_file_handle(fi);
+    file_entry_t *entry = handle ? fs_inode_entry(state, handle->inode) : fs_find_file(path, state);
+    if (entry == NULL) {
+        res = -ENOENT;
+    } else if (entry->type == 1) {
+        res = -EISDIR;
+    } else {
+        res = fs_extent_seek(state, entry, offset, whence);
+    }
+    fs_request_unlock(state, fi, slot);
+    
+    return res;
+}
+
+int fs_utimens(const char *path, const struct timespec tv[2], struct fuse_file_info *fi) {
+    (void) fi;
+    
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
+    int res = 0;
+    int32_t slot = fs_request_lock(state, path, NULL, 1);
+    file_entry_t *entry = fs_path_entry(state, path, slot);
     uint32_t uid = getuid();
-    uint32_t gid = getgid();
+    
+    if (entry == NULL) {
+        res = -ENOENT;
+    } else if (uid != entry->uid && uid != 0) {
+        // فقط مالک یا root می‌تواند زمان فایل را تغییر دهد
+        res = -EPERM;
+    } else {
+        // زمان معوق lazytime اول نوشته می‌شود تا release بعدی زمان صریح را عوض نکند
+        if (slot >= 0) {
+            fs_lazytime_flush_slot(state, slot);
+        }
+        uint32_t now = fs_now();
+        if (tv[0].tv_nsec != UTIME_OMIT) {
+            entry->atime = tv[0].tv_nsec == UTIME_NOW ? now : tv[0].tv_sec;
+        }
+        if (tv[1].tv_nsec != UTIME_OMIT) {
+            entry->mtime = tv[1].tv_nsec == UTIME_NOW ? now : tv[1].tv_sec;
+        }
+    }
+    fs_request_unlock(state, NULL, slot);
+    
+    return res;
+}
+
+static int fs_access_visit(file_entry_t *entry, void *arg) {
+    return fs_check_permission(entry, getuid(), getgid(), *(uint32_t *)arg);
+}
+
+int fs_access(const char *path, int mask) {
+    struct fs_state *state = get_fs_state();
+    if (!state) return -EIO;
+    
     uint32_t required_perms = 0;
     
     // تبدیل mask به مجوزهای ما
@@ -582,10 +1456,11 @@ int fs_access(const char *path, int mask) {
     if (mask & W_OK) required_perms |= 2;  // نوشتن
     if (mask & X_OK) required_perms |= 1;  // اجرا
     
-    return fs_check_permission(file, uid, gid, required_perms);
+    return fs_peek_path(state, path, fs_access_visit, &required_perms);
 }
 
 // توابع مدیریت دسترسی‌ها (برای CLI)
+// CLI فقط روی image جدا شده اجرا می‌شود، پس کش کرنلی برای باطل کردن نیست
 
 int fs_chmod(const char *path, mode_t mode, struct fs_state *state) {
     if (!state || !path) return -EINVAL;
@@ -602,7 +1477,7 @@ int fs_chmod(const char *path, mode_t mode, struct fs_state *state) {
     }
     
     file->permissions = mode & 0777;  // فقط 9 بیت آخر
-    file->mtime = time(NULL);
+    file->mtime = fs_now();
     
     printf("Permissions changed for %s: %o\n", path, file->permissions);
     return 0;
@@ -639,7 +1514,7 @@ int fs_chown(const char *path, uint32_t uid, uint32_t gid, struct fs_state *stat
         file->gid = gid;
     }
     
-    file->ctime = time(NULL);
+    file->ctime = fs_now();
     
     printf("Ownership changed for %s: UID=%u, GID=%u\n", path, file->uid, file->gid);
     return 0;
@@ -1,6 +1,7 @@
 #ifndef GENERAL_FS_H
 #define GENERAL_FS_H
 
+#define _GNU_SOURCE  // SEEK_DATA و SEEK_HOLE
 #define FUSE_USE_VERSION 31
 #include <fuse3/fuse.h>
 #include <stdint.h>
@@ -15,18 +16,23 @@
 #include <time.h>
 #include <pwd.h>
 #include <grp.h>
+#include <pthread.h>
 
 #define MAGIC_NUMBER 0x4D4F4445  // "MODE" در هگز
-#define VERSION 3  // نسخه رو افزایش می‌دیم
+#define VERSION 9  // نسخه 9: فایل‌های sparse (حفره در نقشه extent)
 #define BLOCK_SIZE 4096
 #define MAX_FILENAME 256
-#define MAX_FILES 1000
+#define FS_CHUNK_FILES 1000  // entryهای هر تکه جدول فایل (تکه 0 جدول ثابت بعد از گروه‌هاست)
+#define FS_MAX_CHUNKS 1000
+#define MAX_FILES (FS_CHUNK_FILES * FS_MAX_CHUNKS)
 #define MAX_USERS 100
 #define MAX_GROUPS 50
 #define MAX_USERNAME 32
 #define MAX_GROUPNAME 32
 #define MAX_FREE_BLOCKS 100
 #define FS_SIZE (100 * 1024 * 1024) // 100MB
+#define FS_TOTAL_BLOCKS (FS_SIZE / BLOCK_SIZE)
+#define FS_BITMAP_BLOCKS ((FS_TOTAL_BLOCKS / 8 + BLOCK_SIZE - 1) / BLOCK_SIZE)
 
 // ساختار سوپر بلاک
 typedef struct {
@@ -37,7 +43,13 @@ typedef struct {
     uint32_t user_count;
     uint32_t group_count;
     uint32_t free_block_count;
-    uint8_t padding[BLOCK_SIZE - 28];
+    uint32_t generation;    // شمارنده نسل برای entryهای جدید
+    uint32_t chunk_count;   // تعداد تکه‌های جدول فایل
+    uint32_t chunks[FS_MAX_CHUNKS];  // آفست بایتی هر تکه روی دیسک
+    uint32_t slot_count;    // اسلات‌های استفاده شده تا حالا (زنده یا حذف شده)
+    uint32_t free_slot;     // اولین اسلات حذف شده + 1، صفر یعنی لیست خالی
+    uint32_t bitmap_offset; // آفست بایتی bitmap بلوک‌ها (یک بیت برای هر بلوک، 1 یعنی استفاده شده)
+    uint8_t padding[BLOCK_SIZE - 48 - 4 * FS_MAX_CHUNKS];
 } superblock_t;
 
 // ساختار کاربر
@@ -60,22 +72,57 @@ typedef struct {
     uint8_t padding[BLOCK_SIZE - (MAX_GROUPNAME + 205)];
 } group_entry_t;
 
-// ساختار entry فایل
+// ساختار entry فایل: فقط فیلدهای پرکاربرد (64 بایت)، نام در file_names
 typedef struct {
-    char name[MAX_FILENAME];
     uint32_t type;          // 0: file, 1: directory
     uint32_t permissions;   // مجوزهای دسترسی
     uint32_t size;
-    uint32_t data_offset;
-    uint32_t data_blocks;
+    uint32_t data_offset;   // آفست بایتی extent اول
+    uint32_t data_blocks;   // طول نقشه extent (بلوک، همراه با حفره‌ها)
     uint32_t uid;           // User ID مالک
     uint32_t gid;           // Group ID مالک
     uint32_t atime;
     uint32_t mtime;
     uint32_t ctime;
-    uint8_t padding[BLOCK_SIZE - (MAX_FILENAME + 44)];
+    uint32_t parent;        // اسلات دایرکتوری والد + 1، صفر یعنی ریشه
+    uint32_t generation;    // نسل entry (برای شماره inode در FUSE lowlevel)
+    union {
+        uint32_t next_free;     // فقط در اسلات حذف شده: اسلات آزاد بعدی + 1
+        uint32_t alloc_blocks;  // فقط در entry زنده: بلوک‌های واقعاً تخصیص داده شده
+    };
+    uint32_t inline_blocks; // طول extent اول (بلوک)
+    uint32_t extent_block;  // اولین بلوک extent (extentهای دوم به بعد)، صفر یعنی ندارد
+    uint32_t extent_count;  // تعداد کل extentها
 } file_entry_t;
 
+// هر تکه: FS_CHUNK_FILES رکورد فایل و بعد از آن نام‌های همان اسلات‌ها
+#define FS_CHUNK_BYTES (FS_CHUNK_FILES * (sizeof(file_entry_t) + MAX_FILENAME))
+#define FS_CHUNK_BLOCKS ((FS_CHUNK_BYTES + BLOCK_SIZE - 1) / BLOCK_SIZE)
+
+// یک محدوده پیوسته از بلوک‌های داده فایل
+typedef struct {
+    uint32_t start_block;
+    uint32_t block_count;
+} fs_extent_t;
+
+// start_block حفره (بلوک 0 سوپر بلاک است و هیچ‌وقت داده فایل نیست)
+#define FS_HOLE 0
+
+#define FS_EXTENTS_PER_BLOCK ((BLOCK_SIZE - 8) / sizeof(fs_extent_t))
+
+// بلوک extent: extentهای دوم به بعد فایل در زنجیره‌ای از این بلوک‌ها
+typedef struct {
+    uint32_t next_block;    // بلوک extent بعدی، صفر یعنی آخرین
+    uint32_t reserved;
+    fs_extent_t extents[FS_EXTENTS_PER_BLOCK];
+} extent_block_t;
+
+// type اسلات حذف شده (0: فایل، 1: دایرکتوری)
+#define FS_TYPE_FREE 2
+
+// شناسه دایرکتوری ریشه (دایرکتوری‌های دیگر: اسلات + 1)
+#define FS_ROOT_DIR 0
+
 // ساختار ACL برای دسترسی‌های پیشرفته
 typedef struct acl_entry {
     uint32_t uid_or_gid;    // UID یا GID
@@ -84,24 +131,244 @@ typedef struct acl_entry {
     struct acl_entry *next;
 } acl_entry_t;
 
-// ساختار بلوک خالی در لیست پیوندی
+// pool اشیای هم‌اندازه (pool.c) برای گره‌های کوچک پرتعداد مثل free_block_t و acl_entry_t
+#define FS_POOL_CHUNK_BYTES 65536
+
+typedef struct fs_pool_chunk {
+    struct fs_pool_chunk *next;
+} fs_pool_chunk_t;
+
+typedef struct {
+    size_t object_size;       // صفر یعنی هنوز fs_pool_init نشده
+    uint32_t per_chunk;
+    uint32_t chunk_count;
+    uint64_t in_use;
+    void *free_objects;       // لیست اشیای آزاد شده
+    char *bump;               // ادامه تکه فعلی که هنوز به کسی داده نشده
+    char *bump_end;
+    fs_pool_chunk_t *chunks;
+} fs_pool_t;
+
+// درخت‌های ایندکس بلوک‌های خالی
+#define FREE_BY_OFFSET 0    // کلید: start_block (برای ادغام با همسایه‌ها)
+#define FREE_BY_SIZE 1      // کلید: block_count و بعد start_block (برای best-fit)
+
+// ساختار بلوک خالی: در لیست مرتب بر اساس آفست و در دو درخت AVL
 typedef struct free_block {
     uint32_t start_block;
     uint32_t block_count;
     struct free_block *next;
+    struct free_block *prev;
+    struct free_block *child[2][2];  // [درخت][چپ/راست]
+    int8_t height[2];
 } free_block_t;
 
+// گروه تخصیص: یک محدوده پیوسته از بلوک‌ها با ایندکس و قفل خودش تا
+// نویسنده‌های هم‌زمان فایل‌های مختلف پشت یک قفل نمانند (free_list.c)
+#define FS_MAX_ALLOC_GROUPS 16
+
+typedef struct {
+    pthread_mutex_t lock;
+    free_block_t *free_list;          // ابتدای لیست مرتب بلوک‌های خالی گروه
+    free_block_t *free_tree[2];       // ریشه درخت‌های FREE_BY_OFFSET و FREE_BY_SIZE
+    uint32_t free_blocks;             // مجموع بلوک‌های خالی گروه
+    fs_pool_t pool;                   // گره‌های free_block_t
+} fs_alloc_group_t;
+
+// ایندکس هش (والد، نام) -> اسلات در file_table و لیست فرزندان هر دایرکتوری
+// (فقط در حافظه، هنگام mount ساخته می‌شود)
+typedef struct {
+    uint32_t *slots;        // اسلات + 1، صفر یعنی خانه خالی
+    uint32_t *hashes;       // هش نام برای مقایسه سریع قبل از strcmp
+    uint32_t capacity;      // توانی از دو
+    uint32_t count;
+    uint32_t *first_child;  // برای هر dir id: اولین فرزند + 1
+    uint32_t *child_count;  // برای هر dir id: تعداد فرزندان
+    uint32_t *next_sibling; // برای هر اسلات: فرزند بعدی همان والد + 1
+    uint32_t *prev_sibling; // برای هر اسلات: فرزند قبلی همان والد + 1 (حذف O(1))
+    void **retired;         // آرایه‌های هش قدیمی که خواننده‌های بدون قفل شاید هنوز بخوانند
+    uint32_t retired_count;
+} file_index_t;
+
+// inode حافظه: ارجاع به یک اسلات که بعد از حذف entry هم معتبر می‌ماند
+typedef struct fs_inode {
+    uint32_t slot;          // اسلات در جدول فایل (ثابت)
+    uint32_t generation;
+    uint64_t refcount;      // lookupهای کرنل و handleهای باز
+    uint8_t unlinked;       // entry حذف شده ولی هنوز ارجاع دارد
+    uint8_t cache_valid;    // auto_cache: mtime/size آخرین open ثبت شده
+    uint32_t cache_mtime;
+    uint32_t cache_size;
+    uint32_t prealloc_end;  // data_blocks بعد از آخرین پیش‌تخصیص حدسی، صفر یعنی ندارد
+    uint32_t lazy_atime;    // lazytime: زمان‌هایی که هنوز در entry نوشته نشده‌اند، صفر یعنی ندارد
+    uint32_t lazy_mtime;
+} fs_inode_t;
+
+// handle فایل باز (در fi->fh): ارجاع به inode و نتیجه بررسی دسترسی در open
+typedef struct fs_handle {
+    fs_inode_t *inode;
+    int flags;              // پرچم‌های open
+    uint8_t can_read;
+    uint8_t can_write;
+} fs_handle_t;
+
+// تنظیمات کش کرنل (از گزینه‌های -o در خط فرمان)
+typedef struct {
+    double entry_timeout;     // اعتبار نام‌ها (ثانیه)
+    double attr_timeout;      // اعتبار stat (ثانیه)
+    double negative_timeout;  // اعتبار "وجود ندارد" (ثانیه، صفر یعنی خاموش)
+    int kernel_cache;         // نگه داشتن page cache بین openها
+    int auto_cache;           // نگه داشتن page cache اگر mtime و size تغییر نکرده
+} fs_cache_config_t;
+
+// پس دادن فضای آزاد به میزبان: بازه‌های خالی بزرگ از فایل image پانچ می‌شوند
+#define FS_DISCARD_MIN 16         // کوچک‌ترین بازه خالی که پانچ می‌شود (بلوک)
+#define FS_DISCARD_QUEUE 256      // ظرفیت صف بازه‌های در انتظار
+#define FS_DISCARD_BATCH 32       // با این تعداد بازه worker زودتر بیدار می‌شود
+#define FS_DISCARD_INTERVAL 1     // حداکثر تأخیر پانچ (ثانیه)
+
+// صف پانچ و worker پس‌زمینه آن
+typedef struct {
+    pthread_mutex_t lock;     // صف؛ worker هنگام پانچ آن را نگه می‌دارد
+    pthread_cond_t wake;
+    pthread_t thread;
+    int running;              // فقط وقتی worker فعال است بازه‌ها صف می‌شوند
+    int stop;
+    int disabled;             // سیستم فایل میزبان پانچ را پشتیبانی نمی‌کند
+    uint32_t count;
+    fs_extent_t pending[FS_DISCARD_QUEUE];
+    uint64_t punched_blocks;
+    uint64_t punch_calls;
+} fs_discard_t;
+
+// defrag: فایل‌های تکه‌تکه به محدوده پیوسته منتقل و فضای خالی به هم چسبانده می‌شود
+#define FS_DEFRAG_MAX_BLOCKS 1024   // بزرگ‌ترین فایلی که autodefrag هنگام release جابجا می‌کند
+#define FS_DEFRAG_RATE 4096         // بودجه جابجایی autodefrag (بلوک در ثانیه)
+
+typedef struct {
+    int autodefrag;           // -o autodefrag
+    pthread_mutex_t lock;     // بودجه بین releaseهای هم‌زمان
+    double tokens;            // بودجه باقی‌مانده (بلوک)
+    struct timespec last;     // آخرین پر شدن بودجه
+} fs_defrag_config_t;
+
+// میزان تکه‌تکه شدن فایل‌ها و فضای خالی
+typedef struct {
+    uint32_t files;           // entryهای دارای بلوک داده
+    uint32_t fragmented;      // فایل‌های با بیش از یک تکه فیزیکی
+    uint32_t fragments;       // مجموع تکه‌های همه فایل‌ها
+    uint32_t free_extents;
+    uint32_t largest_free;
+    uint32_t free_blocks;
+} fs_frag_stats_t;
+
+// دستگاه بلوکی داده فایل‌ها (blockdev.c): mmap، یا pread/pwrite با کش بافر
+#define FS_BDEV_MMAP 0
+#define FS_BDEV_PIO 1
+#define FS_CACHE_SHARDS 16          // هر بلوک در تکه block % FS_CACHE_SHARDS
+#define FS_CACHE_DEFAULT_MB 16      // اندازه پیش‌فرض کش بافر (-o cache_mb=N)
+
+typedef struct {
+    uint32_t block;           // FS_HOLE یعنی فریم خالی
+    uint8_t referenced;       // بیت CLOCK
+    uint8_t dirty;
+    int32_t next;             // فریم بعدی همان زنجیره هش، -1 پایان
+} fs_cache_frame_t;
+
+// یک تکه کش: فریم‌ها، هش بلوک به فریم و عقربه CLOCK زیر یک mutex
+typedef struct {
+    pthread_mutex_t lock;
+    fs_cache_frame_t *frames;
+    char *data;               // frame_count بلوک، هم‌تراز برای O_DIRECT
+    int32_t *hash;
+    uint32_t frame_count;
+    uint32_t hash_mask;
+    uint32_t hand;
+    uint32_t dirty_count;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t writebacks;
+} fs_cache_shard_t;
+
+struct fs_state;
+
+// backend: io با out خواندن، با in نوشتن و با هر دو NULL صفر کردن [offset, offset + size)
+// است. splice یعنی داده در page cache فایل image است و بافرهای fd با آن سازگارند
+typedef struct {
+    const char *name;
+    int splice;
+    int (*io)(struct fs_state *state, uint64_t offset, char *out, const char *in, size_t size);
+    void (*forget)(struct fs_state *state, uint32_t start_block, uint32_t block_count);
+    int (*flush)(struct fs_state *state, uint32_t start_block, uint32_t block_count);
+} fs_bdev_ops_t;
+
+typedef struct {
+    int backend;              // -o blockdev=mmap|pio
+    int direct;               // -o o_direct (همراه pio)
+    uint32_t cache_mb;        // -o cache_mb=N، صفر یعنی پیش‌فرض
+    const fs_bdev_ops_t *ops; // NULL تا fs_bdev_open (مثل mmap رفتار می‌شود)
+    int fd;                   // fd ورودی/خروجی pio (با O_DIRECT جدا از state->fd)
+    fs_cache_shard_t shards[FS_CACHE_SHARDS];
+} fs_blockdev_t;
+
+// به‌روزرسانی atime هنگام خواندن (-o relatime|strictatime|noatime)
+#define FS_ATIME_RELATIME 0         // فقط اگر از mtime/ctime عقب‌تر یا قدیمی‌تر از یک روز باشد
+#define FS_ATIME_STRICT 1           // هر خواندن
+#define FS_ATIME_NOATIME 2          // هرگز
+#define FS_RELATIME_SECONDS (24 * 60 * 60)
+
+// سطح‌های لاگ (log.c)
+#define FS_LOG_ERROR 0
+#define FS_LOG_WARN 1
+#define FS_LOG_INFO 2
+#define FS_LOG_DEBUG 3
+#ifndef FS_LOG_MAX_LEVEL
+#define FS_LOG_MAX_LEVEL FS_LOG_DEBUG
+#endif
+#define FS_LOG_RING 1024            // رکوردهای بافر حلقوی هر نخ
+#define FS_LOG_LINE 224             // حداکثر طول یک پیام
+#define FS_LOG_INTERVAL_MS 20       // فاصله خالی کردن بافرها وقتی worker بیکار است
+
+// خواندن بدون قفل (locks.c): تعداد تلاش قبل از برگشت به قفل‌ها
+#define FS_SEQ_RETRIES 4
+
+typedef struct {
+    pthread_rwlock_t lock;
+    uint32_t seq;             // شمارنده نوشتن entry (فرد = در حال تغییر)
+} fs_slot_lock_t;
+
 // ساختار state برای FUSE
 struct fs_state {
     char *disk_file;
     int fd;
     void *data;
     superblock_t *superblock;
-    file_entry_t *file_table;
     user_entry_t *user_table;
     group_entry_t *group_table;
-    free_block_t *free_list;
+    fs_alloc_group_t alloc_groups[FS_MAX_ALLOC_GROUPS];  // بلوک‌های خالی هر گروه
+    uint32_t alloc_group_count;       // صفر یعنی هنوز fs_init_free_list نشده
+    uint32_t alloc_group_blocks;      // اندازه هر گروه (مضرب 64)
+    uint32_t alloc_next_group;        // گروه خانگی نخ بعدی
+    uint8_t *block_bitmap;            // bitmap بلوک‌ها روی دیسک (منبع اصلی فضای خالی)
+    fs_pool_t acl_pool;               // گره‌های acl_entry_t
     acl_entry_t **file_acls;  // لیست ACL برای هر فایل
+    file_index_t file_index;  // جستجوی O(1) فایل‌ها بر اساس نام
+    fs_inode_t **inodes;      // inodeهای حافظه برای هر اسلات (یا NULL)
+    fs_cache_config_t cache;  // تنظیمات کش کرنل
+    fs_discard_t discard;     // پانچ فضای آزاد در فایل image
+    fs_defrag_config_t defrag;
+    fs_blockdev_t bdev;       // مسیر داده فایل‌ها؛ متادیتا همیشه از mmap خوانده می‌شود
+    int copy_read;            // -o copy_read: خواندن با کپی در بافر به جای splice از image
+    int copy_write;           // -o copy_write: نوشتن با کپی در بافر به جای splice به image
+    int singlethread;         // -s: حلقه تک‌نخی (read_buf سطح بالا فقط آن‌جا splice می‌کند)
+    int atime_mode;           // FS_ATIME_*
+    int lazytime;             // -o lazytime: زمان‌های تنها تغییر entry تا release در inode حافظه می‌مانند
+    // قفل‌ها (locks.c)
+    pthread_rwlock_t ns_lock;         // فضای نام
+    uint32_t ns_seq;                  // شمارنده نوشتن فضای نام (فرد = در حال تغییر)
+    pthread_mutex_t icache_lock;      // inodeهای حافظه
+    fs_slot_lock_t *slot_locks[FS_MAX_CHUNKS];  // قفل هر اسلات، یک آرایه برای هر تکه
+    int locks_ready;
 };
 
 // توابع مدیریت دیسک
@@ -111,8 +378,74 @@ void fs_disk_close(struct fs_state *state);
 
 // توابع مدیریت فایل
 file_entry_t *fs_find_file(const char *path, struct fs_state *state);
+int32_t fs_find_slot(const char *path, struct fs_state *state);
+int fs_lookup_parent(const char *path, struct fs_state *state, uint32_t *dir, const char **name);
 int fs_create_file(const char *path, mode_t mode, uint32_t type, struct fs_state *state);
-int fs_resize_file(file_entry_t *entry, uint32_t new_size, struct fs_state *state);
+int fs_create_entry(struct fs_state *state, uint32_t dir, const char *filename, mode_t mode, uint32_t type);
+int fs_remove_entry(struct fs_state *state, uint32_t dir, const char *name, int is_dir);
+void fs_remove_orphan(struct fs_state *state, uint32_t slot);
+void fs_reclaim_orphans(struct fs_state *state);
+int fs_resize_file(file_entry_t *entry, uint64_t new_size, struct fs_state *state);
+void fs_fill_stat(file_entry_t *entry, struct stat *stbuf);
+int fs_open_entry(file_entry_t *entry, int flags);
+int fs_read_entry(struct fs_state *state, file_entry_t *entry, fs_inode_t *inode,
+                  char *buf, size_t size, off_t offset);
+int fs_read_entry_buf(struct fs_state *state, file_entry_t *entry, fs_inode_t *inode, size_t size,
+                      off_t offset, int use_fd, struct fuse_bufvec **out);
+int fs_write_entry(struct fs_state *state, file_entry_t *entry, fs_inode_t *inode,
+                   const char *buf, size_t size, off_t offset);
+int fs_write_entry_buf(struct fs_state *state, file_entry_t *entry, fs_inode_t *inode,
+                       struct fuse_bufvec *src, off_t offset);
+int fs_fallocate_entry(struct fs_state *state, file_entry_t *entry, int mode, off_t offset, off_t length);
+void fs_prealloc_append(struct fs_state *state, fs_inode_t *inode, size_t size, off_t offset);
+void fs_prealloc_trim(struct fs_state *state, fs_inode_t *inode);
+
+// توابع جدول فایل (تکه‌ها)
+uint32_t fs_table_capacity(struct fs_state *state);
+file_entry_t *fs_entry(struct fs_state *state, uint32_t slot);
+char *fs_entry_name(struct fs_state *state, uint32_t slot);
+int fs_table_grow(struct fs_state *state);
+
+// توابع extentهای فایل
+int fs_extent_grow(struct fs_state *state, file_entry_t *entry, uint32_t block_count);
+int fs_extent_grow_hole(struct fs_state *state, file_entry_t *entry, uint32_t block_count);
+void fs_extent_truncate(struct fs_state *state, file_entry_t *entry, uint32_t block_count);
+int fs_extent_punch(struct fs_state *state, file_entry_t *entry, uint32_t first_block, uint32_t block_count);
+int fs_extent_fill(struct fs_state *state, file_entry_t *entry, uint32_t first_block, uint32_t block_count);
+uint32_t fs_extent_fragments(struct fs_state *state, file_entry_t *entry, uint32_t *first_block);
+int fs_extent_relocate(struct fs_state *state, file_entry_t *entry, uint32_t start_block);
+off_t fs_extent_seek(struct fs_state *state, file_entry_t *entry, off_t offset, int whence);
+int fs_extent_read(struct fs_state *state, file_entry_t *entry, char *buf, size_t size, off_t offset);
+int fs_extent_write(struct fs_state *state, file_entry_t *entry, const char *buf, size_t size, off_t offset);
+int fs_extent_zero(struct fs_state *state, file_entry_t *entry, size_t size, off_t offset);
+int fs_extent_flush(struct fs_state *state, file_entry_t *entry);
+int fs_extent_bufvec(struct fs_state *state, file_entry_t *entry, size_t size, off_t offset,
+                     struct fuse_bufvec **out);
+
+// توابع ایندکس فایل‌ها
+int fs_index_build(struct fs_state *state);
+int fs_index_resize(struct fs_state *state, uint32_t capacity);
+void fs_index_free(struct fs_state *state);
+int fs_index_insert(struct fs_state *state, uint32_t slot);
+void fs_index_remove(struct fs_state *state, uint32_t slot);
+int32_t fs_index_lookup(struct fs_state *state, uint32_t dir, const char *name);
+int32_t fs_index_first_child(struct fs_state *state, uint32_t dir);
+int32_t fs_index_next_child(struct fs_state *state, uint32_t slot);
+uint32_t fs_index_child_count(struct fs_state *state, uint32_t dir);
+
+// توابع inodeهای حافظه
+int fs_icache_init(struct fs_state *state);
+int fs_icache_resize(struct fs_state *state, uint32_t capacity);
+void fs_icache_free(struct fs_state *state);
+fs_inode_t *fs_inode_get(struct fs_state *state, uint32_t slot);
+void fs_inode_put(struct fs_state *state, fs_inode_t *inode, uint64_t count);
+file_entry_t *fs_inode_entry(struct fs_state *state, fs_inode_t *inode);
+int fs_icache_detach(struct fs_state *state, uint32_t slot);
+int fs_handle_open(struct fs_state *state, uint32_t slot, int flags, fs_handle_t **out);
+fs_inode_t *fs_handle_release(struct fs_state *state, fs_handle_t *handle);
+fs_handle_t *fs_file_handle(struct fuse_file_info *fi);
+int32_t fs_inode_slot(fs_inode_t *inode);
+int32_t fs_handle_slot(fs_handle_t *handle);
 
 // توابع مدیریت کاربران و گروه‌ها
 int fs_add_user(const char *username, uint32_t uid, uint32_t gid, struct fs_state *state);
@@ -134,26 +467,127 @@ void fs_print_acl(const char *path, struct fs_state *state);
 
 // توابع مدیریت بلوک‌های خالی
 int fs_alloc_blocks(uint32_t block_count, struct fs_state *state, uint32_t *start_block);
+int fs_alloc_blocks_near(uint32_t goal_block, uint32_t block_count, struct fs_state *state,
+                         uint32_t *start_block);
+int fs_reserve_blocks(uint32_t start_block, uint32_t block_count, struct fs_state *state);
+uint32_t fs_alloc_blocks_upto(uint32_t goal_block, uint32_t max_count, struct fs_state *state,
+                              uint32_t *start_block);
+uint32_t fs_alloc_blocks_at(uint32_t start_block, uint32_t max_count, struct fs_state *state);
+uint32_t fs_largest_free(struct fs_state *state);
 int fs_free_blocks(uint32_t start_block, uint32_t block_count, struct fs_state *state);
+uint32_t fs_free_total(struct fs_state *state);
+void fs_free_walk(struct fs_state *state, int (*visit)(const free_block_t *node, void *arg), void *arg);
+uint32_t fs_bitmap_mark(struct fs_state *state, uint32_t start_block, uint32_t block_count, int used);
 void fs_print_free_list(struct fs_state *state);
 void fs_visualize_free_space(struct fs_state *state);
 
 // توابع کمکی
 struct fs_state *get_fs_state(void);
 void fs_init_free_list(struct fs_state *state);
+void fs_free_list_destroy(struct fs_state *state);
+
+// قفل‌ها (locks.c)
+int fs_locks_init(struct fs_state *state);
+int fs_slot_locks_grow(struct fs_state *state, uint32_t chunk_count);
+void fs_locks_destroy(struct fs_state *state);
+void fs_ns_rdlock(struct fs_state *state);
+void fs_ns_wrlock(struct fs_state *state);
+void fs_ns_unlock(struct fs_state *state);
+void fs_slot_rdlock(struct fs_state *state, int32_t slot);
+void fs_slot_wrlock(struct fs_state *state, int32_t slot);
+void fs_slot_unlock(struct fs_state *state, int32_t slot);
+uint32_t fs_ns_seq_begin(struct fs_state *state);
+int fs_ns_seq_retry(struct fs_state *state, uint32_t seq);
+uint32_t fs_slot_seq_begin(struct fs_state *state, int32_t slot);
+int fs_slot_seq_retry(struct fs_state *state, int32_t slot, uint32_t seq);
+
+// pool اشیای هم‌اندازه
+void fs_pool_init(fs_pool_t *pool, size_t object_size);
+void *fs_pool_alloc(fs_pool_t *pool);
+void fs_pool_free(fs_pool_t *pool, void *object);
+void fs_pool_destroy(fs_pool_t *pool);
+
+// defrag (defrag.c)
+void fs_frag_stats(struct fs_state *state, fs_frag_stats_t *stats);
+void fs_frag_print(const char *label, const fs_frag_stats_t *stats);
+int fs_defrag_file(struct fs_state *state, uint32_t slot);
+int fs_defrag(struct fs_state *state);
+void fs_autodefrag(struct fs_state *state, uint32_t slot);
+
+// لاگ (log.c)؛ پیام‌های بالاتر از FS_LOG_MAX_LEVEL در زمان کامپایل حذف می‌شوند
+// و بقیه با fs_log_level (-o log_level=...) در زمان اجرا فیلتر می‌شوند
+extern int fs_log_level;
+void fs_log_write(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+int fs_log_start(void);
+void fs_log_stop(void);
+int fs_log_parse_level(const char *name);
+
+#define fs_log(level, ...) do { \
+        if ((level) <= FS_LOG_MAX_LEVEL && (level) <= fs_log_level) fs_log_write((level), __VA_ARGS__); \
+    } while (0)
+#define fs_log_error(...) fs_log(FS_LOG_ERROR, __VA_ARGS__)
+#define fs_log_warn(...) fs_log(FS_LOG_WARN, __VA_ARGS__)
+#define fs_log_info(...) fs_log(FS_LOG_INFO, __VA_ARGS__)
+#define fs_log_debug(...) fs_log(FS_LOG_DEBUG, __VA_ARGS__)
+
+// زمان‌های فایل (timestamps.c)
+uint32_t fs_now(void);
+void fs_touch_atime(struct fs_state *state, file_entry_t *entry, fs_inode_t *inode);
+void fs_touch_mtime(struct fs_state *state, file_entry_t *entry, fs_inode_t *inode, int dirty);
+void fs_lazytime_flush(file_entry_t *entry, fs_inode_t *inode);
+void fs_lazytime_flush_slot(struct fs_state *state, uint32_t slot);
+uint32_t fs_lazytime_mtime(file_entry_t *entry, fs_inode_t *inode);
+void fs_lazytime_stat(fs_inode_t *inode, struct stat *stbuf);
+
+// پانچ فضای آزاد در فایل image (discard.c)
+int fs_discard_start(struct fs_state *state);
+void fs_discard_stop(struct fs_state *state);
+void fs_discard_queue(struct fs_state *state, uint32_t start_block, uint32_t block_count);
+void fs_discard_cancel(struct fs_state *state, uint32_t start_block, uint32_t block_count);
+void fs_discard_sweep(struct fs_state *state);
+
+// دستگاه بلوکی داده فایل‌ها (blockdev.c)؛ خطای ورودی/خروجی -EIO است
+int fs_bdev_open(struct fs_state *state, const char *disk_file);
+void fs_bdev_close(struct fs_state *state);
+int fs_bdev_io(struct fs_state *state, uint64_t offset, char *out, const char *in, size_t size);
+int fs_bdev_copy(struct fs_state *state, uint32_t dst_block, uint32_t src_block, uint32_t block_count);
+void fs_bdev_forget(struct fs_state *state, uint32_t start_block, uint32_t block_count);
+int fs_bdev_flush(struct fs_state *state, uint32_t start_block, uint32_t block_count);
+int fs_bdev_sync(struct fs_state *state, int datasync);
+int fs_bdev_splice(struct fs_state *state);
 
 // توابع FUSE
 int fs_getattr(const char *path, struct stat *stbuf, struct fuse_file_info *fi);
 int fs_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi, enum fuse_readdir_flags flags);
 int fs_open(const char *path, struct fuse_file_info *fi);
 int fs_read(const char *path, char *buf, size_t size, off_t offset, struct fuse_file_info *fi);
+int fs_read_buf(const char *path, struct fuse_bufvec **bufp, size_t size, off_t offset,
+                struct fuse_file_info *fi);
 int fs_write(const char *path, const char *buf, size_t size, off_t offset, struct fuse_file_info *fi);
+int fs_write_buf(const char *path, struct fuse_bufvec *buf, off_t offset, struct fuse_file_info *fi);
 int fs_create(const char *path, mode_t mode, struct fuse_file_info *fi);
 int fs_unlink(const char *path);
 int fs_truncate(const char *path, off_t size, struct fuse_file_info *fi);
+int fs_fallocate(const char *path, int mode, off_t offset, off_t length, struct fuse_file_info *fi);
+off_t fs_lseek(const char *path, off_t offset, int whence, struct fuse_file_info *fi);
+int fs_release(const char *path, struct fuse_file_info *fi);
+int fs_flush(const char *path, struct fuse_file_info *fi);
+int fs_fsync(const char *path, int datasync, struct fuse_file_info *fi);
+void *fs_init(struct fuse_conn_info *conn, struct fuse_config *cfg);
 int fs_utimens(const char *path, const struct timespec tv[2], struct fuse_file_info *fi);
 int fs_mkdir(const char *path, mode_t mode);
 int fs_rmdir(const char *path);
 int fs_access(const char *path, int mask);
 
+// frontend جایگزین بر پایه fuse_lowlevel (شماره inode به جای مسیر)
+int fs_lowlevel_main(int argc, char *argv[], struct fs_state *state);
+
+// کش کرنل
+int fs_parse_cache_opts(struct fuse_args *args, fs_cache_config_t *cache);
+int fs_parse_defrag_opts(struct fuse_args *args, fs_defrag_config_t *defrag);
+int fs_parse_splice_opts(struct fuse_args *args, struct fs_state *state);
+int fs_parse_atime_opts(struct fuse_args *args, struct fs_state *state);
+int fs_parse_log_opts(struct fuse_args *args);
+int fs_parse_bdev_opts(struct fuse_args *args, fs_blockdev_t *bdev);
+
 #endif
\ No newline at end of file
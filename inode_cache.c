@@ -0,0 +1,169 @@
+#include "general_fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// مقداردهی اولیه جدول inodeهای حافظه (یک اشاره‌گر برای هر اسلات)
+int fs_icache_init(struct fs_state *state) {
+    state->inodes = calloc(fs_table_capacity(state), sizeof(fs_inode_t *));
+    return state->inodes ? 0 : -ENOMEM;
+}
+
+// هم‌اندازه کردن جدول inodeها با ظرفیت جدید جدول فایل
+int fs_icache_resize(struct fs_state *state, uint32_t capacity) {
+    uint32_t old = fs_table_capacity(state);
+
+    // forget بدون ns_lock به جدول دست می‌زند
+    pthread_mutex_lock(&state->icache_lock);
+    fs_inode_t **inodes = realloc(state->inodes, capacity * sizeof(fs_inode_t *));
+    if (inodes) {
+        memset(inodes + old, 0, (capacity - old) * sizeof(fs_inode_t *));
+        state->inodes = inodes;
+    }
+    pthread_mutex_unlock(&state->icache_lock);
+
+    return inodes ? 0 : -ENOMEM;
+}
+
+void fs_icache_free(struct fs_state *state) {
+    if (!state->inodes) return;
+
+    for (uint32_t i = 0; i < fs_table_capacity(state); i++) {
+        free(state->inodes[i]);
+    }
+    free(state->inodes);
+    state->inodes = NULL;
+}
+
+// گرفتن inode حافظه برای یک اسلات و افزایش شمارنده ارجاع
+fs_inode_t *fs_inode_get(struct fs_state *state, uint32_t slot) {
+    pthread_mutex_lock(&state->icache_lock);
+    fs_inode_t *inode = state->inodes[slot];
+
+    if (!inode) {
+        inode = calloc(1, sizeof(fs_inode_t));
+        if (!inode) {
+            pthread_mutex_unlock(&state->icache_lock);
+            return NULL;
+        }
+
+        inode->slot = slot;
+        inode->generation = fs_entry(state, slot)->generation;
+        state->inodes[slot] = inode;
+    }
+
+    inode->refcount++;
+    pthread_mutex_unlock(&state->icache_lock);
+    return inode;
+}
+
+// کاهش شمارنده ارجاع به اندازه count؛ در صفر، inode آزاد می‌شود و اگر
+// entry آن حذف شده بود، بلوک‌ها و اسلات هم (صدا زننده نباید قفلی نگه دارد)
+void fs_inode_put(struct fs_state *state, fs_inode_t *inode, uint64_t count) {
+    if (!inode) return;
+
+    pthread_mutex_lock(&state->icache_lock);
+    if (count >= inode->refcount) {
+        int orphan = inode->unlinked;
+        state->inodes[inode->slot] = NULL;
+        pthread_mutex_unlock(&state->icache_lock);
+
+        if (orphan) {
+            fs_remove_orphan(state, inode->slot);
+        }
+        free(inode);
+        return;
+    }
+
+    inode->refcount -= count;
+    pthread_mutex_unlock(&state->icache_lock);
+}
+
+// entry مربوط به inode؛ بعد از unlink هم تا آخرین ارجاع معتبر است
+file_entry_t *fs_inode_entry(struct fs_state *state, fs_inode_t *inode) {
+    if (!inode) return NULL;
+    return fs_entry(state, inode->slot);
+}
+
+// نام entry اسلات حذف شد؛ اگر inode آن هنوز ارجاع دارد علامت unlinked
+// می‌خورد و یک برمی‌گردد (entry تا fs_inode_put آخر آزاد نمی‌شود)
+// unlinked زیر قفل انحصاری اسلات تغییر می‌کند و بدون قفل هم خوانده می‌شود
+int fs_icache_detach(struct fs_state *state, uint32_t slot) {
+    pthread_mutex_lock(&state->icache_lock);
+    fs_inode_t *inode = state->inodes[slot];
+
+    if (inode) {
+        __atomic_store_n(&inode->unlinked, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&state->icache_lock);
+    return inode != NULL;
+}
+
+// باز کردن handle روی یک اسلات: بررسی دسترسی فقط همین‌جا انجام می‌شود
+// و نتیجه آن برای read/write بعدی نگه داشته می‌شود
+int fs_handle_open(struct fs_state *state, uint32_t slot, int flags, fs_handle_t **out) {
+    file_entry_t *entry = fs_entry(state, slot);
+
+    int res = fs_open_entry(entry, flags);
+    if (res < 0) {
+        return res;
+    }
+
+    fs_handle_t *handle = calloc(1, sizeof(fs_handle_t));
+    if (!handle) {
+        return -ENOMEM;
+    }
+
+    handle->inode = fs_inode_get(state, slot);
+    if (!handle->inode) {
+        free(handle);
+        return -ENOMEM;
+    }
+
+    int accmode = flags & O_ACCMODE;
+    handle->flags = flags;
+    handle->can_read = accmode != O_WRONLY &&
+                       fs_check_permission(entry, getuid(), getgid(), 4) == 0;
+    handle->can_write = accmode != O_RDONLY &&
+                        fs_check_permission(entry, getuid(), getgid(), 2) == 0;
+
+    *out = handle;
+    return 0;
+}
+
+// بستن handle زیر قفل انحصاری اسلات؛ ارجاع inode برگردانده می‌شود تا صدا زننده
+// بعد از آزاد کردن قفل با fs_inode_put پس بدهد
+fs_inode_t *fs_handle_release(struct fs_state *state, fs_handle_t *handle) {
+    if (!handle) return NULL;
+
+    // lazytime: زمان‌های معوق inode حالا در entry نوشته می‌شوند
+    file_entry_t *entry = fs_inode_entry(state, handle->inode);
+    if (entry) {
+        fs_lazytime_flush(entry, handle->inode);
+    }
+
+    if (handle->can_write) {
+        fs_prealloc_trim(state, handle->inode);
+        if (!handle->inode->unlinked) {
+            fs_autodefrag(state, handle->inode->slot);
+        }
+    }
+    fs_inode_t *inode = handle->inode;
+    free(handle);
+    return inode;
+}
+
+// handle ذخیره شده در fi->fh (یا NULL برای عملیات بدون open)
+fs_handle_t *fs_file_handle(struct fuse_file_info *fi) {
+    if (!fi) return NULL;
+    return (fs_handle_t *)(uintptr_t)fi->fh;
+}
+
+// اسلاتی که باید برای inode قفل شود؛ تا ارجاع داریم آزاد نمی‌شود
+int32_t fs_inode_slot(fs_inode_t *inode) {
+    return inode->slot;
+}
+
+int32_t fs_handle_slot(fs_handle_t *handle) {
+    return handle ? fs_inode_slot(handle->inode) : -1;
+}
@@ -0,0 +1,69 @@
+#include "general_fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// تعداد اسلات‌های موجود در تکه‌های فعلی جدول فایل
+uint32_t fs_table_capacity(struct fs_state *state) {
+    return state->superblock->chunk_count * FS_CHUNK_FILES;
+}
+
+// ابتدای تکه‌ای که اسلات در آن است
+static char *chunk_base(struct fs_state *state, uint32_t slot) {
+    return (char *)state->data + state->superblock->chunks[slot / FS_CHUNK_FILES];
+}
+
+// رکورد فایل یک اسلات
+file_entry_t *fs_entry(struct fs_state *state, uint32_t slot) {
+    return (file_entry_t *)chunk_base(state, slot) + slot % FS_CHUNK_FILES;
+}
+
+// نام یک اسلات (بعد از رکوردهای همان تکه)
+char *fs_entry_name(struct fs_state *state, uint32_t slot) {
+    char *names = chunk_base(state, slot) + FS_CHUNK_FILES * sizeof(file_entry_t);
+    return names + (size_t)(slot % FS_CHUNK_FILES) * MAX_FILENAME;
+}
+
+// بزرگ کردن آرایه ACLها هم‌اندازه جدول
+static int acl_resize(struct fs_state *state, uint32_t capacity) {
+    uint32_t old = fs_table_capacity(state);
+    acl_entry_t **acls = realloc(state->file_acls, capacity * sizeof(acl_entry_t *));
+    if (!acls) {
+        return -ENOMEM;
+    }
+
+    memset(acls + old, 0, (capacity - old) * sizeof(acl_entry_t *));
+    state->file_acls = acls;
+    return 0;
+}
+
+// اضافه کردن یک تکه جدید به جدول فایل از فضای داده
+// هزینه هر رشد ثابت است و فقط هر FS_CHUNK_FILES فایل یک بار رخ می‌دهد
+int fs_table_grow(struct fs_state *state) {
+    superblock_t *sb = state->superblock;
+    if (sb->chunk_count >= FS_MAX_CHUNKS) {
+        return -ENOSPC;
+    }
+
+    uint32_t start_block;
+    if (fs_alloc_blocks(FS_CHUNK_BLOCKS, state, &start_block) < 0) {
+        return -ENOSPC;
+    }
+
+    // ساختارهای حافظه قبل از افزایش chunk_count بزرگ می‌شوند
+    uint32_t capacity = fs_table_capacity(state) + FS_CHUNK_FILES;
+    if (fs_index_resize(state, capacity) < 0 ||
+        fs_icache_resize(state, capacity) < 0 ||
+        acl_resize(state, capacity) < 0 ||
+        fs_slot_locks_grow(state, sb->chunk_count + 1) < 0) {
+        fs_free_blocks(start_block, FS_CHUNK_BLOCKS, state);
+        return -ENOMEM;
+    }
+
+    memset((char *)state->data + start_block * BLOCK_SIZE, 0, FS_CHUNK_BLOCKS * BLOCK_SIZE);
+    sb->chunks[sb->chunk_count++] = start_block * BLOCK_SIZE;
+
+    fs_log_info("File table grown to %u slots (chunk at block %u)",
+                fs_table_capacity(state), start_block);
+    return 0;
+}
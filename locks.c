@@ -0,0 +1,173 @@
+#include "general_fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// مدل هم‌زمانی هسته:
+//   ns_lock (rwlock): فضای نام، یعنی index، جدول فایل، اسلات‌ها و تکه‌ها.
+//     create/unlink/mkdir/rmdir آن را انحصاری و بقیه عملیات‌ها اشتراکی
+//     در تمام مدت درخواست نگه می‌دارند
+//   قفل هر اسلات (rwlock): entry و داده یک فایل؛ خواندن اشتراکی، تغییر انحصاری
+//   قفل هر گروه تخصیص (mutex): extentهای خالی و bitmap آن گروه، داخل free_list.c
+//   icache_lock (mutex): refcount و جدول inodeهای حافظه، داخل inode_cache.c
+//   قفل هر تکه کش بافر (mutex): فریم‌های آن تکه، داخل blockdev.c
+// ترتیب گرفتن: ns_lock، قفل اسلات، بعد یک قفل گروه یا icache_lock (و صف discard)
+// یا یک قفل تکه کش
+//
+// خواندن بدون قفل (seqlock): هر نویسنده ns_lock یا قفل انحصاری اسلات، شمارنده
+// ns_seq یا seq آن اسلات را در طول تغییر فرد نگه می‌دارد. stat و access
+// entry را بدون قفل می‌خوانند و اگر شمارنده‌ها بین شروع و پایان عوض شده
+// باشند نتیجه را دور می‌ریزند و دوباره تلاش می‌کنند. حافظه‌ای که چنین
+// خواننده‌ای شاید هنوز ببیند (آرایه‌های هش قدیمی ایندکس) تا unmount آزاد نمی‌شود
+
+int fs_locks_init(struct fs_state *state) {
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    // create/unlink زیر بار سنگین خواندن و نوشتن گرسنه نمانند
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    int res = pthread_rwlock_init(&state->ns_lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    if (res != 0) {
+        return -res;
+    }
+
+    pthread_mutex_init(&state->icache_lock, NULL);
+    pthread_mutex_init(&state->defrag.lock, NULL);
+    memset(state->slot_locks, 0, sizeof(state->slot_locks));
+    state->ns_seq = 0;
+    state->locks_ready = 1;
+    return 0;
+}
+
+// ساخت قفل‌های اسلات برای chunk_count تکه اول (بعد از mount و قبل از رشد جدول)
+// هر تکه آرایه خودش را دارد تا آدرس قفل‌ها با رشد جدول عوض نشود
+int fs_slot_locks_grow(struct fs_state *state, uint32_t chunk_count) {
+    for (uint32_t chunk = 0; chunk < chunk_count; chunk++) {
+        if (state->slot_locks[chunk]) continue;
+
+        fs_slot_lock_t *locks = malloc(FS_CHUNK_FILES * sizeof(fs_slot_lock_t));
+        if (!locks) {
+            return -ENOMEM;
+        }
+        for (uint32_t i = 0; i < FS_CHUNK_FILES; i++) {
+            pthread_rwlock_init(&locks[i].lock, NULL);
+            locks[i].seq = 0;
+        }
+        // خواننده‌های بدون قفل آرایه را قبل از رشد ایندکس نمی‌بینند
+        __atomic_store_n(&state->slot_locks[chunk], locks, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+void fs_locks_destroy(struct fs_state *state) {
+    if (!state->locks_ready) return;
+
+    for (uint32_t chunk = 0; chunk < FS_MAX_CHUNKS; chunk++) {
+        fs_slot_lock_t *locks = state->slot_locks[chunk];
+        if (!locks) continue;
+
+        for (uint32_t i = 0; i < FS_CHUNK_FILES; i++) {
+            pthread_rwlock_destroy(&locks[i].lock);
+        }
+        free(locks);
+        state->slot_locks[chunk] = NULL;
+    }
+
+    pthread_mutex_destroy(&state->defrag.lock);
+    pthread_mutex_destroy(&state->icache_lock);
+    pthread_rwlock_destroy(&state->ns_lock);
+    state->locks_ready = 0;
+}
+
+// نویسنده بعد از گرفتن قفل انحصاری شمارنده را فرد می‌کند
+static void seq_write_begin(uint32_t *seq) {
+    __atomic_store_n(seq, __atomic_load_n(seq, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+// قبل از رها کردن قفل دوباره زوج می‌شود؛ دارنده قفل اشتراکی همیشه زوج
+// می‌بیند، پس فرد بودن یعنی این نخ نویسنده بوده است
+static void seq_write_end(uint32_t *seq) {
+    uint32_t value = __atomic_load_n(seq, __ATOMIC_RELAXED);
+    if (value & 1) {
+        __atomic_store_n(seq, value + 1, __ATOMIC_RELEASE);
+    }
+}
+
+static uint32_t seq_read_begin(uint32_t *seq) {
+    return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+}
+
+// غیر صفر اگر خواندن با نوشتنی هم‌زمان بوده و باید تکرار شود
+static int seq_read_retry(uint32_t *seq, uint32_t start) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (start & 1) || __atomic_load_n(seq, __ATOMIC_RELAXED) != start;
+}
+
+void fs_ns_rdlock(struct fs_state *state) {
+    pthread_rwlock_rdlock(&state->ns_lock);
+}
+
+void fs_ns_wrlock(struct fs_state *state) {
+    pthread_rwlock_wrlock(&state->ns_lock);
+    seq_write_begin(&state->ns_seq);
+}
+
+void fs_ns_unlock(struct fs_state *state) {
+    seq_write_end(&state->ns_seq);
+    pthread_rwlock_unlock(&state->ns_lock);
+}
+
+// قفل اسلات؛ اسلات منفی (ریشه) قفل ندارد. خواننده بدون قفل ممکن است
+// اسلات تکه‌ای را ببیند که آرایه قفلش هنوز برایش دیده نمی‌شود
+static fs_slot_lock_t *slot_lock(struct fs_state *state, int32_t slot) {
+    if (slot < 0) return NULL;
+
+    fs_slot_lock_t *locks = __atomic_load_n(&state->slot_locks[slot / FS_CHUNK_FILES], __ATOMIC_ACQUIRE);
+    return locks ? &locks[slot % FS_CHUNK_FILES] : NULL;
+}
+
+void fs_slot_rdlock(struct fs_state *state, int32_t slot) {
+    fs_slot_lock_t *lock = slot_lock(state, slot);
+    if (lock) pthread_rwlock_rdlock(&lock->lock);
+}
+
+void fs_slot_wrlock(struct fs_state *state, int32_t slot) {
+    fs_slot_lock_t *lock = slot_lock(state, slot);
+    if (lock) {
+        pthread_rwlock_wrlock(&lock->lock);
+        seq_write_begin(&lock->seq);
+    }
+}
+
+void fs_slot_unlock(struct fs_state *state, int32_t slot) {
+    fs_slot_lock_t *lock = slot_lock(state, slot);
+    if (lock) {
+        seq_write_end(&lock->seq);
+        pthread_rwlock_unlock(&lock->lock);
+    }
+}
+
+// شروع خواندن بدون قفل فضای نام (lookup مسیر)
+uint32_t fs_ns_seq_begin(struct fs_state *state) {
+    return seq_read_begin(&state->ns_seq);
+}
+
+int fs_ns_seq_retry(struct fs_state *state, uint32_t seq) {
+    return seq_read_retry(&state->ns_seq, seq);
+}
+
+// شروع خواندن بدون قفل entry یک اسلات؛ ریشه همیشه معتبر است و
+// اسلاتی که آرایه قفلش هنوز دیده نمی‌شود همیشه تکرار می‌شود
+uint32_t fs_slot_seq_begin(struct fs_state *state, int32_t slot) {
+    if (slot < 0) return 0;
+
+    fs_slot_lock_t *lock = slot_lock(state, slot);
+    return lock ? seq_read_begin(&lock->seq) : 1;
+}
+
+int fs_slot_seq_retry(struct fs_state *state, int32_t slot, uint32_t seq) {
+    if (slot < 0) return 0;
+
+    fs_slot_lock_t *lock = slot_lock(state, slot);
+    return lock ? seq_read_retry(&lock->seq, seq) : 1;
+}
@@ -0,0 +1,228 @@
+#include "general_fs.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <strings.h>
+
+// لاگ سطح‌دار بدون قفل روی مسیر درخواست‌ها:
+//   هر نخ یک بافر حلقوی (یک نویسنده، یک خواننده) دارد و پیام را همان‌جا
+//   قالب‌بندی می‌کند؛ نه قفل stdio می‌گیرد و نه write می‌کند. اگر بافر پر باشد
+//   پیام دور ریخته و شمرده می‌شود و نخ هرگز منتظر نمی‌ماند
+//   یک worker پس‌زمینه بافرها را هر FS_LOG_INTERVAL_MS خالی می‌کند و خروجی هر
+//   دور را با یک fwrite روی stdout می‌نویسد (ترتیب فقط در هر نخ حفظ می‌شود)
+//   قبل از fs_log_start و بعد از fs_log_stop (cli، راه‌اندازی، bench) پیام مستقیم
+//   نوشته می‌شود
+//   بافر نخی که خارج شده به نخ بعدی داده می‌شود؛ بافرها تا پایان پروسه می‌مانند
+
+typedef struct {
+    struct timespec time;
+    int level;
+    char msg[FS_LOG_LINE];
+} log_record_t;
+
+typedef struct log_ring {
+    log_record_t records[FS_LOG_RING];
+    uint32_t head;              // فقط نخ صاحب می‌نویسد
+    uint32_t tail;              // فقط worker می‌نویسد
+    uint32_t dropped;           // پیام‌های دور ریخته از آخرین خالی شدن
+    uint32_t owned;             // یک نخ زنده صاحب بافر است
+    uint32_t id;                // شماره نخ در خروجی
+    struct log_ring *next;
+} log_ring_t;
+
+int fs_log_level = FS_LOG_INFO;
+
+static struct {
+    log_ring_t *rings;          // فقط اضافه می‌شود (CAS روی سر لیست)
+    uint32_t ring_count;
+    int running;
+    int stop;
+    pthread_t thread;
+    pthread_key_t key;
+    int key_ready;
+} logger;
+
+static __thread log_ring_t *thread_ring;
+
+static const char *level_names[] = { "ERROR", "WARN", "INFO", "DEBUG" };
+
+// بافر برای worker آزاد می‌شود؛ رکوردهای خالی نشده برای صاحب بعدی می‌مانند
+static void ring_release(void *arg) {
+    log_ring_t *ring = arg;
+    __atomic_store_n(&ring->owned, 0, __ATOMIC_RELEASE);
+}
+
+// بافر نخ فعلی: بافر رها شده یک نخ قبلی، یا یک بافر تازه
+static log_ring_t *ring_get(void) {
+    if (thread_ring) {
+        return thread_ring;
+    }
+
+    log_ring_t *ring;
+    for (ring = __atomic_load_n(&logger.rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        uint32_t free_ring = 0;
+        if (__atomic_compare_exchange_n(&ring->owned, &free_ring, 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    if (!ring) {
+        ring = calloc(1, sizeof(log_ring_t));
+        if (!ring) {
+            return NULL;
+        }
+        ring->owned = 1;
+        ring->id = __atomic_add_fetch(&logger.ring_count, 1, __ATOMIC_RELAXED);
+        ring->next = __atomic_load_n(&logger.rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&logger.rings, &ring->next, ring, 0,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        }
+    }
+
+    pthread_setspecific(logger.key, ring);
+    thread_ring = ring;
+    return ring;
+}
+
+// یک خط خروجی: زمان، سطح، نخ (صفر یعنی بدون بافر) و پیام
+static int format_line(char *out, size_t size, const struct timespec *time, int level,
+                       uint32_t id, const char *msg) {
+    struct tm tm;
+    localtime_r(&time->tv_sec, &tm);
+    return snprintf(out, size, "%02d:%02d:%02d.%03ld %-5s t%u %s\n",
+                    tm.tm_hour, tm.tm_min, tm.tm_sec, time->tv_nsec / 1000000,
+                    level_names[level], id, msg);
+}
+
+void fs_log_write(int level, const char *fmt, ...) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    log_ring_t *ring = __atomic_load_n(&logger.running, __ATOMIC_ACQUIRE) ? ring_get() : NULL;
+    if (!ring) {
+        char msg[FS_LOG_LINE];
+        char line[FS_LOG_LINE + 64];
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(msg, sizeof(msg), fmt, args);
+        va_end(args);
+        format_line(line, sizeof(line), &now, level, 0, msg);
+        fputs(line, stdout);
+        return;
+    }
+
+    uint32_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= FS_LOG_RING) {
+        __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    log_record_t *record = &ring->records[head % FS_LOG_RING];
+    record->time = now;
+    record->level = level;
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(record->msg, sizeof(record->msg), fmt, args);
+    va_end(args);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// خالی کردن همه بافرها در out؛ تعداد بایت‌های نوشته شده
+static size_t drain(char *out, size_t size) {
+    size_t used = 0;
+
+    for (log_ring_t *ring = __atomic_load_n(&logger.rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        uint32_t tail = ring->tail;
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        // هر خط حداکثر FS_LOG_LINE + 64 بایت است؛ باقی در دور بعد
+        while (tail != head && size - used > FS_LOG_LINE + 64) {
+            log_record_t *record = &ring->records[tail % FS_LOG_RING];
+            used += format_line(out + used, size - used, &record->time, record->level,
+                                ring->id, record->msg);
+            tail++;
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+        uint32_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+        if (dropped && size - used > FS_LOG_LINE + 64) {
+            char msg[64];
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            __atomic_sub_fetch(&ring->dropped, dropped, __ATOMIC_RELAXED);
+            snprintf(msg, sizeof(msg), "%u log messages dropped", dropped);
+            used += format_line(out + used, size - used, &now, FS_LOG_WARN, ring->id, msg);
+        }
+    }
+    return used;
+}
+
+static void *log_worker(void *arg) {
+    (void) arg;
+    static char out[FS_LOG_RING * (FS_LOG_LINE + 64)];
+
+    for (;;) {
+        int stop = __atomic_load_n(&logger.stop, __ATOMIC_ACQUIRE);
+        size_t used = drain(out, sizeof(out));
+        if (used > 0) {
+            fwrite(out, 1, used, stdout);
+            fflush(stdout);
+        }
+        if (stop && used == 0) {
+            break;
+        }
+        // بیکار: تا دور بعد می‌خوابد؛ با خروجی پر بلافاصله دوباره خالی می‌کند
+        if (used == 0) {
+            struct timespec delay = { 0, FS_LOG_INTERVAL_MS * 1000000L };
+            nanosleep(&delay, NULL);
+        }
+    }
+    return NULL;
+}
+
+// شروع worker؛ باید در پروسه نهایی (بعد از daemonize) صدا زده شود
+int fs_log_start(void) {
+    if (logger.running) {
+        return 0;
+    }
+
+    if (!logger.key_ready) {
+        int err = pthread_key_create(&logger.key, ring_release);
+        if (err != 0) {
+            return -err;
+        }
+        logger.key_ready = 1;
+    }
+
+    fflush(stdout);
+    logger.stop = 0;
+    int err = pthread_create(&logger.thread, NULL, log_worker, NULL);
+    if (err != 0) {
+        fs_log_error("cannot start log worker: %s", strerror(err));
+        return -err;
+    }
+
+    __atomic_store_n(&logger.running, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// توقف worker بعد از نوشتن همه پیام‌های باقی‌مانده؛ بعد از آن لاگ مستقیم است
+void fs_log_stop(void) {
+    if (!logger.running) {
+        return;
+    }
+
+    __atomic_store_n(&logger.running, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&logger.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(logger.thread, NULL);
+}
+
+// سطح از نام (error، warn، info، debug)؛ -1 اگر نامعتبر
+int fs_log_parse_level(const char *name) {
+    for (int level = FS_LOG_ERROR; level <= FS_LOG_DEBUG; level++) {
+        if (strcasecmp(name, level_names[level]) == 0) {
+            return level;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,826 @@
+#include "general_fs.h"
+#include <fuse3/fuse_lowlevel.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct fs_state *ll_state(fuse_req_t req) {
+    return (struct fs_state *)fuse_req_userdata(req);
+}
+
+// nodeid برای ریشه FUSE_ROOT_ID و برای بقیه اشاره‌گر به fs_inode_t است؛
+// inode و entry آن بعد از unlink هم تا forget و release آخر زنده می‌مانند
+static fs_inode_t *ll_inode(fuse_ino_t ino) {
+    return (fs_inode_t *)(uintptr_t)ino;
+}
+
+// entry مربوط به nodeid
+static file_entry_t *ll_entry(struct fs_state *state, fuse_ino_t ino) {
+    if (ino == FUSE_ROOT_ID) {
+        return fs_find_file("/", state);
+    }
+    return fs_inode_entry(state, ll_inode(ino));
+}
+
+// شماره inode نمایش داده شده به کاربر: اسلات + 2 (یک برای ریشه)
+static ino_t ll_st_ino(fuse_ino_t ino) {
+    if (ino == FUSE_ROOT_ID) {
+        return FUSE_ROOT_ID;
+    }
+    return ll_inode(ino)->slot + FUSE_ROOT_ID + 1;
+}
+
+// شناسه دایرکتوری برای nodeid
+static int ll_dir_id(struct fs_state *state, fuse_ino_t ino, uint32_t *dir) {
+    if (ino == FUSE_ROOT_ID) {
+        *dir = FS_ROOT_DIR;
+        return 0;
+    }
+
+    // در دایرکتوری حذف شده چیزی ساخته نمی‌شود
+    fs_inode_t *inode = ll_inode(ino);
+    if (__atomic_load_n(&inode->unlinked, __ATOMIC_ACQUIRE)) {
+        return -ENOENT;
+    }
+    file_entry_t *entry = fs_inode_entry(state, inode);
+    if (entry->type != 1) {
+        return -ENOTDIR;
+    }
+
+    *dir = inode->slot + 1;
+    return 0;
+}
+
+// بررسی دسترسی نوشتن در دایرکتوری والد (مثل fs_create، ریشه بررسی نمی‌شود)
+static int ll_check_parent_write(struct fs_state *state, fuse_ino_t parent) {
+    if (parent == FUSE_ROOT_ID) {
+        return 0;
+    }
+    return fs_check_permission(ll_entry(state, parent), getuid(), getgid(), 2);
+}
+
+// اسلات nodeid برای قفل کردن (locks.c)؛ ریشه -1
+static int32_t ll_slot(fuse_ino_t ino) {
+    if (ino == FUSE_ROOT_ID) {
+        return -1;
+    }
+    return fs_inode_slot(ll_inode(ino));
+}
+
+// قفل اسلات nodeid برای یک درخواست؛ nodeid خودش inode است و lookup نمی‌خواهد،
+// پس ns_lock لازم نیست (اسلات تا آخرین ارجاع inode، حتی بعد از unlink، آزاد نمی‌شود)
+static int32_t ll_lock(struct fs_state *state, fuse_ino_t ino, int write) {
+    int32_t slot = ll_slot(ino);
+    if (write) {
+        fs_slot_wrlock(state, slot);
+    } else {
+        fs_slot_rdlock(state, slot);
+    }
+    return slot;
+}
+
+static void ll_unlock(struct fs_state *state, int32_t slot) {
+    fs_slot_unlock(state, slot);
+}
+
+// خواندن entry یک nodeid بدون قفل، فقط با seq اسلات (locks.c)؛
+// بعد از FS_SEQ_RETRIES تلاش ناموفق زیر قفل اسلات اجرا می‌شود
+static int ll_peek(struct fs_state *state, fuse_ino_t ino,
+                   int (*visit)(file_entry_t *entry, void *arg), void *arg) {
+    int32_t slot = ll_slot(ino);
+
+    for (int attempt = 0; attempt < FS_SEQ_RETRIES; attempt++) {
+        uint32_t seq = fs_slot_seq_begin(state, slot);
+        file_entry_t *entry = ll_entry(state, ino);
+        int res = entry ? visit(entry, arg) : -ENOENT;
+        if (!fs_slot_seq_retry(state, slot, seq)) {
+            return res;
+        }
+    }
+
+    fs_slot_rdlock(state, slot);
+    file_entry_t *entry = ll_entry(state, ino);
+    int res = entry ? visit(entry, arg) : -ENOENT;
+    fs_slot_unlock(state, slot);
+    return res;
+}
+
+// ساخت fuse_entry_param برای یک اسلات؛ یک ارجاع lookup روی inode می‌گیرد
+static int ll_make_entry(struct fs_state *state, uint32_t slot, struct fuse_entry_param *e) {
+    fs_inode_t *inode = fs_inode_get(state, slot);
+    if (!inode) {
+        return -ENOMEM;
+    }
+
+    memset(e, 0, sizeof(*e));
+    e->ino = (uintptr_t)inode;
+    e->generation = inode->generation;
+    e->attr_timeout = state->cache.attr_timeout;
+    e->entry_timeout = state->cache.entry_timeout;
+    fs_slot_rdlock(state, slot);
+    fs_fill_stat(fs_entry(state, slot), &e->attr);
+    fs_slot_unlock(state, slot);
+    fs_lazytime_stat(inode, &e->attr);
+    e->attr.st_ino = ll_st_ino(e->ino);
+    return 0;
+}
+
+static void ll_reply_attr(fuse_req_t req, fuse_ino_t ino) {
+    struct fs_state *state = ll_state(req);
+    file_entry_t *entry = ll_entry(state, ino);
+    if (!entry) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    struct stat st;
+    fs_fill_stat(entry, &st);
+    st.st_ino = ll_st_ino(ino);
+    fuse_reply_attr(req, &st, state->cache.attr_timeout);
+}
+
+static void ll_do_lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
+    struct fs_state *state = ll_state(req);
+
+    uint32_t dir;
+    int res = ll_dir_id(state, parent, &dir);
+    if (res < 0) {
+        fuse_reply_err(req, -res);
+        return;
+    }
+
+    struct fuse_entry_param e;
+    int32_t slot = fs_index_lookup(state, dir, name);
+    if (slot < 0) {
+        // entry منفی: کرنل نبودن نام را تا negative_timeout به خاطر می‌سپارد
+        if (state->cache.negative_timeout > 0) {
+            memset(&e, 0, sizeof(e));
+            e.entry_timeout = state->cache.negative_timeout;
+            fuse_reply_entry(req, &e);
+            return;
+        }
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    res = ll_make_entry(state, slot, &e);
+    if (res < 0) {
+        fuse_reply_err(req, -res);
+        return;
+    }
+    fuse_reply_entry(req, &e);
+}
+
+static void ll_lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
+    struct fs_state *state = ll_state(req);
+
+    fs_ns_rdlock(state);
+    ll_do_lookup(req, parent, name);
+    fs_ns_unlock(state);
+}
+
+// forget بدون ns_lock: فقط شمارنده ارجاع زیر icache_lock کم می‌شود
+static void ll_forget(fuse_req_t req, fuse_ino_t ino, uint64_t nlookup) {
+    if (ino != FUSE_ROOT_ID) {
+        fs_inode_put(ll_state(req), ll_inode(ino), nlookup);
+    }
+    fuse_reply_none(req);
+}
+
+static void ll_forget_multi(fuse_req_t req, size_t count, struct fuse_forget_data *forgets) {
+    struct fs_state *state = ll_state(req);
+
+    for (size_t i = 0; i < count; i++) {
+        if (forgets[i].ino != FUSE_ROOT_ID) {
+            fs_inode_put(state, ll_inode(forgets[i].ino), forgets[i].nlookup);
+        }
+    }
+    fuse_reply_none(req);
+}
+
+static int ll_stat_visit(file_entry_t *entry, void *arg) {
+    fs_fill_stat(entry, arg);
+    return 0;
+}
+
+static void ll_getattr(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
+    (void) fi;
+
+    struct fs_state *state = ll_state(req);
+    struct stat st;
+    int res = ll_peek(state, ino, ll_stat_visit, &st);
+    if (res < 0) {
+        fuse_reply_err(req, -res);
+        return;
+    }
+    if (ino != FUSE_ROOT_ID) {
+        fs_lazytime_stat(ll_inode(ino), &st);
+        if (__atomic_load_n(&ll_inode(ino)->unlinked, __ATOMIC_ACQUIRE)) {
+            st.st_nlink = 0;
+        }
+    }
+
+    st.st_ino = ll_st_ino(ino);
+    fuse_reply_attr(req, &st, state->cache.attr_timeout);
+}
+
+static void ll_do_setattr(fuse_req_t req, fuse_ino_t ino, struct stat *attr, int to_set) {
+    struct fs_state *state = ll_state(req);
+    file_entry_t *entry = ll_entry(state, ino);
+    if (!entry) {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    uint32_t uid = getuid();
+    uint32_t now = fs_now();
+    int set_times = to_set & (FUSE_SET_ATTR_ATIME | FUSE_SET_ATTR_MTIME |
+                              FUSE_SET_ATTR_ATIME_NOW | FUSE_SET_ATTR_MTIME_NOW);
+
+    // همه بررسی‌ها قبل از اولین تغییر، تا درخواستی که رد می‌شود نصفه اعمال نشود
+    // مجوزها و زمان‌ها: فقط مالک یا root (مثل fs_utimens)؛ مالکیت: فقط root
+    if (((to_set & FUSE_SET_ATTR_MODE) || set_times) && uid != entry->uid && uid != 0) {
+        fuse_reply_err(req, EPERM);
+        return;
+    }
+    if ((to_set & (FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID)) && uid != 0) {
+        fuse_reply_err(req, EPERM);
+        return;
+    }
+    if (to_set & FUSE_SET_ATTR_SIZE) {
+        if (entry->type == 1) {
+            fuse_reply_err(req, EISDIR);
+            return;
+        }
+        if (fs_check_permission(entry, uid, getgid(), 2) < 0) {
+            fuse_reply_err(req, EACCES);
+            return;
+        }
+    }
+
+    // اندازه اول، چون تنها بخشی است که هنوز ممکن است شکست بخورد (ENOSPC، EFBIG)
+    if (to_set & FUSE_SET_ATTR_SIZE) {
+        int res = fs_resize_file(entry, attr->st_size, state);
+        if (res < 0) {
+            fuse_reply_err(req, -res);
+            return;
+        }
+    }
+
+    if (to_set & FUSE_SET_ATTR_MODE) {
+        entry->permissions = attr->st_mode & 0777;
+        entry->ctime = now;
+    }
+
+    if (to_set & (FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID)) {
+        if (to_set & FUSE_SET_ATTR_UID) entry->uid = attr->st_uid;
+        if (to_set & FUSE_SET_ATTR_GID) entry->gid = attr->st_gid;
+        entry->ctime = now;
+    }
+
+    if (set_times) {
+        // زمان معوق lazytime اول نوشته می‌شود تا release بعدی زمان صریح را عوض نکند
+        if (ino != FUSE_ROOT_ID) {
+            fs_lazytime_flush(entry, ll_inode(ino));
+        }
+        if (to_set & FUSE_SET_ATTR_ATIME_NOW) entry->atime = now;
+        else if (to_set & FUSE_SET_ATTR_ATIME) entry->atime = attr->st_atime;
+        if (to_set & FUSE_SET_ATTR_MTIME_NOW) entry->mtime = now;
+        else if (to_set & FUSE_SET_ATTR_MTIME) entry->mtime = attr->st_mtime;
+    }
+
+    ll_reply_attr(req, ino);
+}
+
+static void ll_setattr(fuse_req_t req, fuse_ino_t ino, struct stat *attr,
+                       int to_set, struct fuse_file_info *fi) {
+    (void) fi;
+
+    struct fs_state *state = ll_state(req);
+    int32_t slot = ll_lock(state, ino, 1);
+    ll_do_setattr(req, ino, attr, to_set);
+    ll_unlock(state, slot);
+}
+
+// پیمایش دایرکتوری برای readdir و readdirplus
+// در حالت plus، stat و یک ارجاع lookup هم برای هر فرزند برگردانده می‌شود
+static void ll_do_readdir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, int plus) {
+    struct fs_state *state = ll_state(req);
+
+    uint32_t dir;
+    int res = ll_dir_id(state, ino, &dir);
+    if (res < 0) {
+        fuse_reply_err(req, -res);
+        return;
+    }
+
+    // بررسی دسترسی خواندن دایرکتوری
+    if (fs_check_permission(ll_entry(state, ino), getuid(), getgid(), 4) < 0) {
+        fuse_reply_err(req, EACCES);
+        return;
+    }
+
+    char *buf = malloc(size);
+    if (!buf) {
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+
+    // آفست هر entry شماره ترتیبی آن در دایرکتوری است (0 و 1 برای . و ..)
+    size_t pos = 0;
+    int32_t child = fs_index_first_child(state, dir);
+    for (off_t index = 0; ; index++) {
+        struct fuse_entry_param e;
+        const char *name;
+        int32_t slot = -1;
+
+        memset(&e, 0, sizeof(e));
+        if (index == 0) {
+            name = ".";
+            e.attr.st_ino = ll_st_ino(ino);
+            e.attr.st_mode = S_IFDIR;
+        } else if (index == 1) {
+            name = "..";
+            e.attr.st_mode = S_IFDIR;
+        } else {
+            if (child < 0) break;
+            slot = child;
+            name = fs_entry_name(state, slot);
+            e.attr.st_ino = slot + FUSE_ROOT_ID + 1;
+            e.attr.st_mode = fs_entry(state, slot)->type == 1 ? S_IFDIR : S_IFREG;
+            child = fs_index_next_child(state, child);
+        }
+
+        if (index < off) continue;
+
+        size_t len;
+        if (!plus) {
+            len = fuse_add_direntry(req, buf + pos, size - pos, name, &e.attr, index + 1);
+        } else {
+            if (slot >= 0 && ll_make_entry(state, slot, &e) < 0) break;
+            len = fuse_add_direntry_plus(req, buf + pos, size - pos, name, &e, index + 1);
+            // entry جا نشد؛ ارجاعی که برایش گرفتیم را پس می‌دهیم
+            if (len > size - pos && slot >= 0) {
+                fs_inode_put(state, ll_inode(e.ino), 1);
+            }
+        }
+        if (len > size - pos) break;
+        pos += len;
+    }
+
+    fuse_reply_buf(req, buf, pos);
+    free(buf);
+}
+
+// نام‌ها و ترتیب فرزندان زیر ns_lock ثابت می‌مانند؛ stat هر فرزند در
+// readdirplus زیر قفل اسلات خودش خوانده می‌شود (ll_make_entry)
+static void ll_readdir_locked(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, int plus) {
+    struct fs_state *state = ll_state(req);
+
+    fs_ns_rdlock(state);
+    int32_t slot = ll_lock(state, ino, 0);
+    ll_do_readdir(req, ino, size, off, plus);
+    ll_unlock(state, slot);
+    fs_ns_unlock(state);
+}
+
+static void ll_readdir(fuse_req_t req, fuse_ino_t ino, size_t size,
+                       off_t off, struct fuse_file_info *fi) {
+    (void) fi;
+    ll_readdir_locked(req, ino, size, off, 0);
+}
+
+static void ll_readdirplus(fuse_req_t req, fuse_ino_t ino, size_t size,
+                           off_t off, struct fuse_file_info *fi) {
+    (void) fi;
+    ll_readdir_locked(req, ino, size, off, 1);
+}
+
+// handle مشترک با frontend سطح بالا؛ دسترسی فقط در open بررسی می‌شود
+// kernel_cache: page cache همیشه نگه داشته می‌شود
+// auto_cache: فقط اگر mtime و size از open قبلی تغییر نکرده باشد
+static void ll_set_keep_cache(struct fs_state *state, fs_inode_t *inode, struct fuse_file_info *fi) {
+    file_entry_t *entry = fs_inode_entry(state, inode);
+
+    if (state->cache.kernel_cache) {
+        fi->keep_cache = 1;
+    } else if (state->cache.auto_cache) {
+        uint32_t mtime = fs_lazytime_mtime(entry, inode);
+        fi->keep_cache = inode->cache_valid &&
+                         inode->cache_mtime == mtime &&
+                         inode->cache_size == entry->size;
+        inode->cache_valid = 1;
+        inode->cache_mtime = mtime;
+        inode->cache_size = entry->size;
+    }
+}
+
+static int ll_open_handle(struct fs_state *state, fuse_ino_t ino, struct fuse_file_info *fi) {
+    fi->fh = 0;
+
+    if (ino == FUSE_ROOT_ID) {
+        return fs_open_entry(ll_entry(state, ino), fi->flags);
+    }
+
+    if (!ll_entry(state, ino)) {
+        return -ENOENT;
+    }
+
+    fs_handle_t *handle;
+    int res = fs_handle_open(state, ll_inode(ino)->slot, fi->flags, &handle);
+    if (res < 0) {
+        return res;
+    }
+
+    fi->fh = (uintptr_t)handle;
+    ll_set_keep_cache(state, ll_inode(ino), fi);
+    return 0;
+}
+
+static void ll_open(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+
+    // open وضعیت auto_cache را در inode می‌نویسد
+    int32_t slot = ll_lock(state, ino, 1);
+    int res = ll_open_handle(state, ino, fi);
+    ll_unlock(state, slot);
+    if (res < 0) {
+        fuse_reply_err(req, -res);
+        return;
+    }
+    fuse_reply_open(req, fi);
+}
+
+static void ll_release(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+
+    // release نوشتنی پیش‌تخصیص را پس می‌دهد و شاید فایل را defrag کند
+    // ارجاع بعد از قفل پس داده می‌شود (آخرین ارجاع فایل حذف شده قفل می‌گیرد)
+    int32_t slot = ll_lock(state, ino, 1);
+    fs_inode_t *inode = fs_handle_release(state, fs_file_handle(fi));
+    ll_unlock(state, slot);
+    fs_inode_put(state, inode, 1);
+    fuse_reply_err(req, 0);
+}
+
+// بلوک‌های کثیف فایل handle در کش بافر pio (ریشه handle ندارد)
+static int ll_flush_file(struct fs_state *state, struct fuse_file_info *fi) {
+    fs_handle_t *handle = fs_file_handle(fi);
+    if (!handle) {
+        return 0;
+    }
+    return fs_extent_flush(state, fs_inode_entry(state, handle->inode));
+}
+
+// flush در هر close: خطای نوشتن بلوک‌ها به close برمی‌گردد
+static void ll_flush(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+    int32_t slot = ll_lock(state, ino, 0);
+    int res = ll_flush_file(state, fi);
+    ll_unlock(state, slot);
+    fuse_reply_err(req, -res);
+}
+
+static void ll_fsync(fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+    int32_t slot = ll_lock(state, ino, 0);
+    int res = ll_flush_file(state, fi);
+    ll_unlock(state, slot);
+    if (res == 0) {
+        res = fs_bdev_sync(state, datasync);
+    }
+    fuse_reply_err(req, -res);
+}
+
+static void ll_do_read(fuse_req_t req, size_t size, off_t off, struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+    fs_handle_t *handle = fs_file_handle(fi);
+    if (!handle) {
+        fuse_reply_err(req, EBADF);
+        return;
+    }
+    file_entry_t *entry = fs_inode_entry(state, handle->inode);
+
+    if (!handle->can_read) {
+        fuse_reply_err(req, EACCES);
+        return;
+    }
+
+    // پاسخ همین‌جا و زیر قفل اسلات فرستاده می‌شود، پس بافرهای fd (splice از
+    // image بدون کپی در فضای کاربر) تا پایان ارسال معتبر می‌مانند
+    struct fuse_bufvec *bufv;
+    int res = fs_read_entry_buf(state, entry, handle->inode, size, off, !state->copy_read, &bufv);
+    if (res < 0) {
+        fuse_reply_err(req, -res);
+        return;
+    }
+
+    fuse_reply_data(req, bufv, FUSE_BUF_SPLICE_MOVE);
+    for (size_t i = 0; i < bufv->count; i++) {
+        if (!(bufv->buf[i].flags & FUSE_BUF_IS_FD)) {
+            free(bufv->buf[i].mem);
+        }
+    }
+    free(bufv);
+}
+
+static void ll_read(fuse_req_t req, fuse_ino_t ino, size_t size,
+                    off_t off, struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+    int32_t slot = ll_lock(state, ino, 0);
+    ll_do_read(req, size, off, fi);
+    ll_unlock(state, slot);
+}
+
+// write و write_buf؛ یکی از buf یا bufv داده را دارد
+static void ll_do_write(fuse_req_t req, const char *buf, struct fuse_bufvec *bufv, size_t size,
+                        off_t off, struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+    fs_handle_t *handle = fs_file_handle(fi);
+    if (!handle) {
+        fuse_reply_err(req, EBADF);
+        return;
+    }
+    file_entry_t *entry = fs_inode_entry(state, handle->inode);
+
+    if (!handle->can_write) {
+        fuse_reply_err(req, EACCES);
+        return;
+    }
+
+    fs_prealloc_append(state, handle->inode, size, off);
+    int res = bufv ? fs_write_entry_buf(state, entry, handle->inode, bufv, off)
+                   : fs_write_entry(state, entry, handle->inode, buf, size, off);
+    if (res < 0) {
+        fuse_reply_err(req, -res);
+        return;
+    }
+    fuse_reply_write(req, res);
+}
+
+static void ll_write(fuse_req_t req, fuse_ino_t ino, const char *buf,
+                     size_t size, off_t off, struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+    int32_t slot = ll_lock(state, ino, 1);
+    ll_do_write(req, buf, NULL, size, off, fi);
+    ll_unlock(state, slot);
+}
+
+// داده در pipe (splice از /dev/fuse) مستقیم به فایل image منتقل می‌شود
+static void ll_write_buf(fuse_req_t req, fuse_ino_t ino, struct fuse_bufvec *bufv,
+                         off_t off, struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+    int32_t slot = ll_lock(state, ino, 1);
+    ll_do_write(req, NULL, bufv, fuse_buf_size(bufv), off, fi);
+    ll_unlock(state, slot);
+}
+
+static void ll_do_fallocate(fuse_req_t req, int mode, off_t offset, off_t length,
+                            struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+    fs_handle_t *handle = fs_file_handle(fi);
+    if (!handle) {
+        fuse_reply_err(req, EBADF);
+        return;
+    }
+    file_entry_t *entry = fs_inode_entry(state, handle->inode);
+
+    if (!handle->can_write) {
+        fuse_reply_err(req, EBADF);
+        return;
+    }
+
+    // بلوک‌های درخواست شده دیگر حدسی نیستند
+    handle->inode->prealloc_end = 0;
+    fuse_reply_err(req, -fs_fallocate_entry(state, entry, mode, offset, length));
+}
+
+static void ll_fallocate(fuse_req_t req, fuse_ino_t ino, int mode,
+                         off_t offset, off_t length, struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+    int32_t slot = ll_lock(state, ino, 1);
+    ll_do_fallocate(req, mode, offset, length, fi);
+    ll_unlock(state, slot);
+}
+
+static void ll_do_lseek(fuse_req_t req, off_t off, int whence, struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+    fs_handle_t *handle = fs_file_handle(fi);
+    if (!handle) {
+        fuse_reply_err(req, EBADF);
+        return;
+    }
+    file_entry_t *entry = fs_inode_entry(state, handle->inode);
+
+    if (whence != SEEK_DATA && whence != SEEK_HOLE) {
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+
+    off_t res = fs_extent_seek(state, entry, off, whence);
+    if (res < 0) {
+        fuse_reply_err(req, -res);
+        return;
+    }
+    fuse_reply_lseek(req, res);
+}
+
+static void ll_lseek(fuse_req_t req, fuse_ino_t ino, off_t off, int whence,
+                     struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+    int32_t slot = ll_lock(state, ino, 0);
+    ll_do_lseek(req, off, whence, fi);
+    ll_unlock(state, slot);
+}
+
+// ایجاد فایل یا دایرکتوری و پر کردن entry پاسخ
+static int ll_make_node(fuse_req_t req, fuse_ino_t parent, const char *name,
+                        mode_t mode, uint32_t type, struct fuse_entry_param *e) {
+    struct fs_state *state = ll_state(req);
+
+    uint32_t dir;
+    int res = ll_dir_id(state, parent, &dir);
+    if (res < 0) {
+        return res;
+    }
+
+    if (ll_check_parent_write(state, parent) < 0) {
+        return -EACCES;
+    }
+
+    int slot = fs_create_entry(state, dir, name, mode, type);
+    if (slot < 0) {
+        return slot;
+    }
+
+    return ll_make_entry(state, slot, e);
+}
+
+// ساخت و حذف نام‌ها ns_lock را انحصاری می‌گیرند
+static void ll_create(fuse_req_t req, fuse_ino_t parent, const char *name,
+                      mode_t mode, struct fuse_file_info *fi) {
+    struct fs_state *state = ll_state(req);
+    struct fuse_entry_param e;
+
+    fs_ns_wrlock(state);
+    int res = ll_make_node(req, parent, name, mode, 0, &e);
+    if (res == 0) {
+        res = ll_open_handle(state, e.ino, fi);
+        if (res < 0) {
+            fs_inode_put(state, ll_inode(e.ino), 1);
+        }
+    }
+    fs_ns_unlock(state);
+
+    if (res < 0) {
+        fuse_reply_err(req, -res);
+        return;
+    }
+    fuse_reply_create(req, &e, fi);
+}
+
+static void ll_mkdir(fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode) {
+    struct fs_state *state = ll_state(req);
+    struct fuse_entry_param e;
+
+    fs_ns_wrlock(state);
+    int res = ll_make_node(req, parent, name, mode | S_IFDIR, 1, &e);
+    fs_ns_unlock(state);
+    if (res < 0) {
+        fuse_reply_err(req, -res);
+        return;
+    }
+    fuse_reply_entry(req, &e);
+}
+
+static void ll_remove(fuse_req_t req, fuse_ino_t parent, const char *name, int is_dir) {
+    struct fs_state *state = ll_state(req);
+
+    uint32_t dir;
+    fs_ns_wrlock(state);
+    int res = ll_dir_id(state, parent, &dir);
+    if (res == 0) {
+        res = fs_remove_entry(state, dir, name, is_dir);
+    }
+    fs_ns_unlock(state);
+    fuse_reply_err(req, -res);
+}
+
+static void ll_unlink(fuse_req_t req, fuse_ino_t parent, const char *name) {
+    ll_remove(req, parent, name, 0);
+}
+
+static void ll_rmdir(fuse_req_t req, fuse_ino_t parent, const char *name) {
+    ll_remove(req, parent, name, 1);
+}
+
+static int ll_access_visit(file_entry_t *entry, void *arg) {
+    return fs_check_permission(entry, getuid(), getgid(), *(uint32_t *)arg);
+}
+
+static void ll_access(fuse_req_t req, fuse_ino_t ino, int mask) {
+    // تبدیل mask به مجوزهای ما
+    uint32_t required_perms = 0;
+    if (mask & R_OK) required_perms |= 4;  // خواندن
+    if (mask & W_OK) required_perms |= 2;  // نوشتن
+    if (mask & X_OK) required_perms |= 1;  // اجرا
+
+    fuse_reply_err(req, -ll_peek(ll_state(req), ino, ll_access_visit, &required_perms));
+}
+
+static void ll_init(void *userdata, struct fuse_conn_info *conn) {
+    struct fs_state *state = userdata;
+
+    // بافرهای fd در read با splice از image به /dev/fuse می‌روند و
+    // داده write_buf با splice از /dev/fuse در pipe می‌ماند
+    if (conn->capable & FUSE_CAP_SPLICE_WRITE) {
+        conn->want |= FUSE_CAP_SPLICE_WRITE;
+    }
+    if (!state->copy_write && (conn->capable & FUSE_CAP_SPLICE_READ)) {
+        conn->want |= FUSE_CAP_SPLICE_READ;
+    }
+}
+
+static const struct fuse_lowlevel_ops fs_ll_oper = {
+    .init         = ll_init,
+    .lookup       = ll_lookup,
+    .forget       = ll_forget,
+    .forget_multi = ll_forget_multi,
+    .getattr      = ll_getattr,
+    .setattr      = ll_setattr,
+    .readdir      = ll_readdir,
+    .readdirplus  = ll_readdirplus,
+    .open         = ll_open,
+    .release      = ll_release,
+    .flush        = ll_flush,
+    .fsync        = ll_fsync,
+    .read         = ll_read,
+    .write        = ll_write,
+    .write_buf    = ll_write_buf,
+    .fallocate    = ll_fallocate,
+    .lseek        = ll_lseek,
+    .create       = ll_create,
+    .mkdir        = ll_mkdir,
+    .unlink       = ll_unlink,
+    .rmdir        = ll_rmdir,
+    .access       = ll_access,
+};
+
+// اجرای فایل سیستم با fuse_lowlevel به جای fuse_main
+int fs_lowlevel_main(int argc, char *argv[], struct fs_state *state) {
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_cmdline_opts opts;
+    struct fuse_session *se;
+    int ret = 1;
+
+    if (fuse_parse_cmdline(&args, &opts) != 0) {
+        return 1;
+    }
+
+    if (opts.show_help) {
+        fuse_cmdline_help();
+        fuse_lowlevel_help();
+        ret = 0;
+        goto out_args;
+    }
+
+    if (!opts.mountpoint) {
+        fprintf(stderr, "No mount point given\n");
+        goto out_args;
+    }
+
+    se = fuse_session_new(&args, &fs_ll_oper, sizeof(fs_ll_oper), state);
+    if (!se) {
+        goto out_mountpoint;
+    }
+
+    if (fuse_set_signal_handlers(se) != 0) {
+        goto out_session;
+    }
+
+    if (fuse_session_mount(se, opts.mountpoint) != 0) {
+        goto out_signals;
+    }
+
+    fuse_daemonize(opts.foreground);
+    fs_log_start();
+    fs_discard_start(state);
+
+    // هسته با locks.c هم‌زمان‌پذیر است؛ -s حلقه تک‌نخی قبلی را انتخاب می‌کند
+    if (opts.singlethread) {
+        ret = fuse_session_loop(se);
+    } else {
+        ret = fuse_session_loop_mt(se, opts.clone_fd);
+    }
+
+    fuse_session_unmount(se);
+out_signals:
+    fuse_remove_signal_handlers(se);
+out_session:
+    fuse_session_destroy(se);
+out_mountpoint:
+    free(opts.mountpoint);
+out_args:
+    fuse_opt_free_args(&args);
+    return ret ? 1 : 0;
+}
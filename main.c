@@ -1,6 +1,7 @@
 #include "general_fs.h"
 #include <signal.h>
 #include <execinfo.h>
+#include <stddef.h>
 
 // Global state variable
 struct fs_state *fs_global_state = NULL;
@@ -44,42 +45,346 @@ void fs_init_users_groups(struct fs_state *state) {
     state->superblock->user_count = 1;
     state->superblock->group_count = 1;
     
-    printf("Initialized users/groups: root user and group created\n");
+    fs_log_info("Initialized users/groups: root user and group created");
+}
+
+// گزینه‌های کش کرنل: -o entry_timeout=T,attr_timeout=T,negative_timeout=T,kernel_cache,auto_cache
+// همه تغییرات متادیتا از درخواست‌های کرنل می‌آیند که کش خودش را به‌روز می‌کند؛
+// دستورات CLI فقط روی image جدا شده اجرا می‌شوند و کش mount زنده را باطل نمی‌کنند
+#define FS_CACHE_OPT(t, p, v) { t, offsetof(fs_cache_config_t, p), v }
+static const struct fuse_opt fs_cache_opts[] = {
+    FS_CACHE_OPT("entry_timeout=%lf", entry_timeout, 0),
+    FS_CACHE_OPT("attr_timeout=%lf", attr_timeout, 0),
+    FS_CACHE_OPT("negative_timeout=%lf", negative_timeout, 0),
+    FS_CACHE_OPT("kernel_cache", kernel_cache, 1),
+    FS_CACHE_OPT("auto_cache", auto_cache, 1),
+    FUSE_OPT_END
+};
+
+// خواندن گزینه‌های کش از args (و حذف آن‌ها از args)؛ پیش‌فرض‌ها مثل libfuse
+int fs_parse_cache_opts(struct fuse_args *args, fs_cache_config_t *cache) {
+    cache->entry_timeout = 1.0;
+    cache->attr_timeout = 1.0;
+    cache->negative_timeout = 0.0;
+    cache->kernel_cache = 0;
+    cache->auto_cache = 0;
+    
+    return fuse_opt_parse(args, cache, fs_cache_opts, NULL);
+}
+
+// -o autodefrag: یکپارچه کردن فایل‌های کوچک تکه‌تکه هنگام بستن
+static const struct fuse_opt fs_defrag_opts[] = {
+    { "autodefrag", offsetof(fs_defrag_config_t, autodefrag), 1 },
+    FUSE_OPT_END
+};
+
+int fs_parse_defrag_opts(struct fuse_args *args, fs_defrag_config_t *defrag) {
+    defrag->autodefrag = 0;
+    defrag->tokens = 0;
+    
+    return fuse_opt_parse(args, defrag, fs_defrag_opts, NULL);
+}
+
+// -o copy_read,copy_write: کپی داده در بافر به جای splice از/به image (برای مقایسه)
+static const struct fuse_opt fs_splice_opts[] = {
+    { "copy_read", offsetof(struct fs_state, copy_read), 1 },
+    { "copy_write", offsetof(struct fs_state, copy_write), 1 },
+    FUSE_OPT_END
+};
+
+int fs_parse_splice_opts(struct fuse_args *args, struct fs_state *state) {
+    state->copy_read = 0;
+    state->copy_write = 0;
+    
+    return fuse_opt_parse(args, state, fs_splice_opts, NULL);
+}
+
+// -o relatime|strictatime|noatime و -o lazytime (timestamps.c)؛ این گزینه‌ها
+// این‌جا مصرف می‌شوند و به mount کرنل نمی‌رسند چون زمان‌ها را خود سیستم فایل می‌نویسد
+static const struct fuse_opt fs_atime_opts[] = {
+    { "relatime", offsetof(struct fs_state, atime_mode), FS_ATIME_RELATIME },
+    { "strictatime", offsetof(struct fs_state, atime_mode), FS_ATIME_STRICT },
+    { "noatime", offsetof(struct fs_state, atime_mode), FS_ATIME_NOATIME },
+    { "lazytime", offsetof(struct fs_state, lazytime), 1 },
+    FUSE_OPT_END
+};
+
+int fs_parse_atime_opts(struct fuse_args *args, struct fs_state *state) {
+    state->atime_mode = FS_ATIME_RELATIME;
+    state->lazytime = 0;
+    
+    return fuse_opt_parse(args, state, fs_atime_opts, NULL);
+}
+
+// -o log_level=error|warn|info|debug (log.c)؛ پیش‌فرض info
+static const struct fuse_opt fs_log_opts[] = {
+    { "log_level=%s", 0, 0 },
+    FUSE_OPT_END
+};
+
+int fs_parse_log_opts(struct fuse_args *args) {
+    char *name = NULL;
+    if (fuse_opt_parse(args, &name, fs_log_opts, NULL) != 0) {
+        return -1;
+    }
+    if (!name) {
+        return 0;
+    }
+    
+    int level = fs_log_parse_level(name);
+    free(name);
+    if (level < 0) {
+        return -1;
+    }
+    fs_log_level = level;
+    return 0;
+}
+
+// -o blockdev=mmap|pio، -o cache_mb=N و -o o_direct (blockdev.c)؛ o_direct بدون
+// کش بافر معنی ندارد و pio را هم روشن می‌کند
+static const struct fuse_opt fs_bdev_opts[] = {
+    { "blockdev=mmap", offsetof(fs_blockdev_t, backend), FS_BDEV_MMAP },
+    { "blockdev=pio", offsetof(fs_blockdev_t, backend), FS_BDEV_PIO },
+    { "cache_mb=%u", offsetof(fs_blockdev_t, cache_mb), 0 },
+    { "o_direct", offsetof(fs_blockdev_t, direct), 1 },
+    FUSE_OPT_END
+};
+
+int fs_parse_bdev_opts(struct fuse_args *args, fs_blockdev_t *bdev) {
+    bdev->backend = FS_BDEV_MMAP;
+    bdev->direct = 0;
+    bdev->cache_mb = 0;
+    
+    if (fuse_opt_parse(args, bdev, fs_bdev_opts, NULL) != 0) {
+        return -1;
+    }
+    if (bdev->direct) {
+        bdev->backend = FS_BDEV_PIO;
+    }
+    return 0;
 }
 
 // عملیات‌های FUSE
 static struct fuse_operations fs_oper = {
+    .init       = fs_init,
     .getattr    = fs_getattr,
     .readdir    = fs_readdir,
     .open       = fs_open,
     .read       = fs_read,
+    .read_buf   = fs_read_buf,
     .write      = fs_write,
+    .write_buf  = fs_write_buf,
     .create     = fs_create,
     .unlink     = fs_unlink,
     .truncate   = fs_truncate,
+    .fallocate  = fs_fallocate,
+    .lseek      = fs_lseek,
+    .release    = fs_release,
+    .flush      = fs_flush,
+    .fsync      = fs_fsync,
     .utimens    = fs_utimens,
     .mkdir      = fs_mkdir,
     .rmdir      = fs_rmdir,
     .access     = fs_access,
 };
 
+// چیدمان متادیتا روی دیسک: سوپر بلاک، کاربران، گروه‌ها، تکه 0 جدول فایل
+// (تکه‌های بعدی جدول فایل از فضای داده گرفته می‌شوند)
+#define FS_FILE_TABLE_OFFSET (sizeof(superblock_t) + \
+                              sizeof(user_entry_t) * MAX_USERS + \
+                              sizeof(group_entry_t) * MAX_GROUPS)
+#define FS_METADATA_END ((FS_FILE_TABLE_OFFSET + FS_CHUNK_BYTES + BLOCK_SIZE - 1) \
+                         / BLOCK_SIZE * BLOCK_SIZE)
+
+// entry فایل در نسخه 3 (یک بلوک کامل برای هر فایل)؛ فقط برای ارتقا
+typedef struct {
+    char name[MAX_FILENAME];
+    uint32_t type;
+    uint32_t permissions;
+    uint32_t size;
+    uint32_t data_offset;
+    uint32_t data_blocks;
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t atime;
+    uint32_t mtime;
+    uint32_t ctime;
+    uint32_t parent;
+    uint32_t generation;
+    uint8_t padding[BLOCK_SIZE - (MAX_FILENAME + 48)];
+} file_entry_v3_t;
+
+static void fs_map_tables(struct fs_state *state) {
+    char *base = (char *)state->data;
+    
+    state->user_table = (user_entry_t *)(base + sizeof(superblock_t));
+    state->group_table = (group_entry_t *)(base + sizeof(superblock_t) + 
+                                          (sizeof(user_entry_t) * MAX_USERS));
+    state->block_bitmap = (uint8_t *)(base + state->superblock->bitmap_offset);
+}
+
+// تکه 0 جدول فایل همیشه در ناحیه ثابت بعد از جدول گروه‌هاست
+static void fs_init_chunk_map(struct fs_state *state) {
+    state->superblock->chunk_count = 1;
+    state->superblock->chunks[0] = FS_FILE_TABLE_OFFSET;
+}
+
+// نسخه 4 یک جدول ثابت داشت که همان تکه 0 است
+static int fs_upgrade_v4(struct fs_state *state) {
+    fs_init_chunk_map(state);
+    state->superblock->version = 5;
+    
+    fs_log_info("Upgraded disk from version 4 to 5");
+    return 0;
+}
+
+// تا نسخه 5 جدول با حذف فشرده می‌شد، پس اسلات حذف شده‌ای وجود ندارد
+static int fs_upgrade_v5(struct fs_state *state) {
+    state->superblock->slot_count = state->superblock->file_count;
+    state->superblock->free_slot = 0;
+    state->superblock->version = 6;
+    
+    fs_log_info("Upgraded disk from version 5 to 6");
+    return 0;
+}
+
+// تا نسخه 6 فضای خالی ذخیره نمی‌شد و هنگام mount فقط بعد از last_used_byte
+// خالی فرض می‌شد (حفره‌ها گم و داده فایل‌ها دوباره تخصیص داده می‌شد)؛
+// bitmap یک بار از روی جدول فایل ساخته و در فضای داده ذخیره می‌شود
+static int fs_upgrade_v6(struct fs_state *state) {
+    superblock_t *sb = state->superblock;
+    uint8_t *bitmap = calloc(FS_BITMAP_BLOCKS, BLOCK_SIZE);
+    if (!bitmap) {
+        fprintf(stderr, "Failed to allocate memory for upgrade\n");
+        return -1;
+    }
+    state->block_bitmap = bitmap;
+    
+    fs_bitmap_mark(state, 0, FS_METADATA_END / BLOCK_SIZE, 1);
+    for (uint32_t i = 1; i < sb->chunk_count; i++) {
+        fs_bitmap_mark(state, sb->chunks[i] / BLOCK_SIZE, FS_CHUNK_BLOCKS, 1);
+    }
+    
+    uint32_t shared = 0;
+    for (uint32_t slot = 0; slot < sb->slot_count; slot++) {
+        file_entry_t *entry = fs_entry(state, slot);
+        if (entry->type == FS_TYPE_FREE || entry->data_blocks == 0) continue;
+        shared += fs_bitmap_mark(state, entry->data_offset / BLOCK_SIZE, entry->data_blocks, 1);
+    }
+    if (shared > 0) {
+        fs_log_warn("%u data blocks are used by more than one file", shared);
+    }
+    
+    // جای خود bitmap از فضای خالی گرفته می‌شود
+    uint32_t start_block;
+    fs_init_free_list(state);
+    int res = fs_alloc_blocks(FS_BITMAP_BLOCKS, state, &start_block);
+    fs_free_list_destroy(state);
+    if (res < 0) {
+        fprintf(stderr, "No space for block bitmap\n");
+        free(bitmap);
+        state->block_bitmap = NULL;
+        return -1;
+    }
+    
+    memcpy((char *)state->data + start_block * BLOCK_SIZE, bitmap, FS_BITMAP_BLOCKS * BLOCK_SIZE);
+    free(bitmap);
+    sb->bitmap_offset = start_block * BLOCK_SIZE;
+    sb->version = 7;
+    
+    fs_log_info("Upgraded disk from version 6 to 7 (bitmap at block %u)", start_block);
+    return 0;
+}
+
+// تا نسخه 7 هر فایل فقط یک extent داشت (data_offset و data_blocks)
+static int fs_upgrade_v7(struct fs_state *state) {
+    for (uint32_t slot = 0; slot < state->superblock->slot_count; slot++) {
+        file_entry_t *entry = fs_entry(state, slot);
+        if (entry->type == FS_TYPE_FREE || entry->data_blocks == 0) continue;
+        entry->inline_blocks = entry->data_blocks;
+        entry->extent_block = 0;
+        entry->extent_count = 1;
+    }
+    state->superblock->version = 8;
+    
+    fs_log_info("Upgraded disk from version 7 to 8");
+    return 0;
+}
+
+// تا نسخه 8 حفره‌ای نبود، پس همه بلوک‌های نقشه تخصیص داده شده‌اند
+static int fs_upgrade_v8(struct fs_state *state) {
+    for (uint32_t slot = 0; slot < state->superblock->slot_count; slot++) {
+        file_entry_t *entry = fs_entry(state, slot);
+        if (entry->type == FS_TYPE_FREE) continue;
+        entry->alloc_blocks = entry->data_blocks;
+    }
+    state->superblock->version = 9;
+    
+    fs_log_info("Upgraded disk from version 8 to 9");
+    return 0;
+}
+
+// تبدیل جدول فایل نسخه 3 به رکوردهای فشرده و ناحیه نام‌ها
+// داده فایل‌ها جابجا نمی‌شود؛ فضای آزاد شده جدول قدیمی به فضای داده برمی‌گردد
+static int fs_upgrade_v3(struct fs_state *state) {
+    uint32_t count = state->superblock->file_count;
+    file_entry_v3_t *old_table = (file_entry_v3_t *)((char *)state->data + FS_FILE_TABLE_OFFSET);
+    
+    // جدول جدید روی جدول قدیمی نوشته می‌شود، پس اول یک کپی می‌گیریم
+    file_entry_v3_t *old = malloc((count ? count : 1) * sizeof(file_entry_v3_t));
+    if (!old) {
+        fprintf(stderr, "Failed to allocate memory for upgrade\n");
+        return -1;
+    }
+    memcpy(old, old_table, count * sizeof(file_entry_v3_t));
+    
+    fs_init_chunk_map(state);
+    memset((char *)state->data + FS_FILE_TABLE_OFFSET, 0, FS_METADATA_END - FS_FILE_TABLE_OFFSET);
+    
+    for (uint32_t i = 0; i < count; i++) {
+        file_entry_t *entry = fs_entry(state, i);
+        
+        strncpy(fs_entry_name(state, i), old[i].name, MAX_FILENAME - 1);
+        entry->type = old[i].type;
+        entry->permissions = old[i].permissions;
+        entry->size = old[i].size;
+        entry->data_offset = old[i].data_offset;
+        entry->data_blocks = old[i].data_blocks;
+        entry->uid = old[i].uid;
+        entry->gid = old[i].gid;
+        entry->atime = old[i].atime;
+        entry->mtime = old[i].mtime;
+        entry->ctime = old[i].ctime;
+        entry->parent = old[i].parent;
+        entry->generation = old[i].generation;
+    }
+    free(old);
+    
+    state->superblock->version = 4;
+    state->superblock->last_used_byte = FS_METADATA_END;
+    
+    fs_log_info("Upgraded disk from version 3 to 4 (%u files)", count);
+    return 0;
+}
+
 // مقداردهی اولیه دیسک
 int fs_disk_init(const char *disk_file, struct fs_state *state) {
-    printf("DEBUG: Initializing disk...\n");
+    fs_log_debug("Initializing disk...");
     
     state->fd = open(disk_file, O_RDWR | O_CREAT | O_TRUNC, 0644);
     if (state->fd == -1) {
         perror("Failed to create disk file");
         return -1;
     }
-    printf("DEBUG: File created with fd: %d\n", state->fd);
+    fs_log_debug("File created with fd: %d", state->fd);
+    fs_locks_init(state);
     
     if (ftruncate(state->fd, FS_SIZE) == -1) {
         perror("Failed to set disk size");
         close(state->fd);
         return -1;
     }
-    printf("DEBUG: File truncated to %d bytes\n", FS_SIZE);
+    fs_log_debug("File truncated to %d bytes", FS_SIZE);
     
     state->data = mmap(NULL, FS_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, state->fd, 0);
     if (state->data == MAP_FAILED) {
@@ -87,64 +392,82 @@ int fs_disk_init(const char *disk_file, struct fs_state *state) {
         close(state->fd);
         return -1;
     }
-    printf("DEBUG: Memory mapping successful at %p\n", state->data);
+    fs_log_debug("Memory mapping successful at %p", state->data);
     
     state->superblock = (superblock_t *)state->data;
-    printf("DEBUG: Superblock at %p\n", state->superblock);
+    fs_log_debug("Superblock at %p", state->superblock);
     
     state->superblock->magic = MAGIC_NUMBER;
     state->superblock->version = VERSION;
-    state->superblock->last_used_byte = sizeof(superblock_t) + 
-                                       (sizeof(user_entry_t) * MAX_USERS) +
-                                       (sizeof(group_entry_t) * MAX_GROUPS) +
-                                       (sizeof(file_entry_t) * MAX_FILES);
+    state->superblock->bitmap_offset = FS_METADATA_END;
+    state->superblock->last_used_byte = FS_METADATA_END + FS_BITMAP_BLOCKS * BLOCK_SIZE;
     state->superblock->file_count = 0;
     state->superblock->user_count = 0;
     state->superblock->group_count = 0;
     state->superblock->free_block_count = 0;
+    state->superblock->slot_count = 0;
+    state->superblock->free_slot = 0;
+    memset(state->superblock->chunks, 0, sizeof(state->superblock->chunks));
+    fs_init_chunk_map(state);
     
     // محاسبه آدرس جداول
-    state->user_table = (user_entry_t *)((char *)state->data + sizeof(superblock_t));
-    state->group_table = (group_entry_t *)((char *)state->data + sizeof(superblock_t) + 
-                                          (sizeof(user_entry_t) * MAX_USERS));
-    state->file_table = (file_entry_t *)((char *)state->data + sizeof(superblock_t) + 
-                                        (sizeof(user_entry_t) * MAX_USERS) +
-                                        (sizeof(group_entry_t) * MAX_GROUPS));
+    fs_map_tables(state);
     
-    printf("DEBUG: User table at %p\n", state->user_table);
-    printf("DEBUG: Group table at %p\n", state->group_table);
-    printf("DEBUG: File table at %p\n", state->file_table);
+    fs_log_debug("User table at %p", state->user_table);
+    fs_log_debug("Group table at %p", state->group_table);
+    fs_log_debug("File table at %p", fs_entry(state, 0));
     
     // صفر کردن حافظه
     memset(state->user_table, 0, sizeof(user_entry_t) * MAX_USERS);
     memset(state->group_table, 0, sizeof(group_entry_t) * MAX_GROUPS);
-    memset(state->file_table, 0, sizeof(file_entry_t) * MAX_FILES);
+    memset(fs_entry(state, 0), 0, FS_CHUNK_BYTES);
+    
+    // متادیتا و خود bitmap استفاده شده‌اند، بقیه دیسک خالی است
+    memset(state->block_bitmap, 0, FS_BITMAP_BLOCKS * BLOCK_SIZE);
+    fs_bitmap_mark(state, 0, state->superblock->last_used_byte / BLOCK_SIZE, 1);
     
     // مقداردهی اولیه لیست بلوک‌های خالی
-    state->free_list = NULL;
     fs_init_free_list(state);
     
+    // ایندکس خالی برای جستجوی فایل‌ها
+    if (fs_index_build(state) < 0 || fs_icache_init(state) < 0 ||
+        fs_slot_locks_grow(state, state->superblock->chunk_count) < 0) {
+        fprintf(stderr, "Failed to allocate file index\n");
+        munmap(state->data, FS_SIZE);
+        close(state->fd);
+        return -1;
+    }
+    
     // مقداردهی اولیه کاربران و گروه‌ها
     fs_init_users_groups(state);
     
     // مقداردهی اولیه ACLها
-    state->file_acls = calloc(MAX_FILES, sizeof(acl_entry_t *));
+    state->file_acls = calloc(fs_table_capacity(state), sizeof(acl_entry_t *));
+    fs_pool_init(&state->acl_pool, sizeof(acl_entry_t));
     
-    printf("General FS initialized successfully\n");
+    // داده فایل‌ها از mmap یا از کش بافر pread/pwrite
+    if (fs_bdev_open(state, disk_file) < 0) {
+        munmap(state->data, FS_SIZE);
+        close(state->fd);
+        return -1;
+    }
+    
+    fs_log_info("General FS initialized successfully");
     fs_print_free_list(state);
     return 0;
 }
 
 // باز کردن دیسک موجود
 int fs_disk_open(const char *disk_file, struct fs_state *state) {
-    printf("DEBUG: Opening existing disk...\n");
+    fs_log_debug("Opening existing disk...");
     
     state->fd = open(disk_file, O_RDWR);
     if (state->fd == -1) {
         perror("Failed to open disk file");
         return -1;
     }
-    printf("DEBUG: File opened with fd: %d\n", state->fd);
+    fs_log_debug("File opened with fd: %d", state->fd);
+    fs_locks_init(state);
     
     state->data = mmap(NULL, FS_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, state->fd, 0);
     if (state->data == MAP_FAILED) {
@@ -152,10 +475,10 @@ int fs_disk_open(const char *disk_file, struct fs_state *state) {
         close(state->fd);
         return -1;
     }
-    printf("DEBUG: Memory mapping successful at %p\n", state->data);
+    fs_log_debug("Memory mapping successful at %p", state->data);
     
     state->superblock = (superblock_t *)state->data;
-    printf("DEBUG: Superblock at %p\n", state->superblock);
+    fs_log_debug("Superblock at %p", state->superblock);
     
     if (state->superblock->magic != MAGIC_NUMBER) {
         fprintf(stderr, "Invalid magic number: 0x%08X\n", state->superblock->magic);
@@ -164,6 +487,18 @@ int fs_disk_open(const char *disk_file, struct fs_state *state) {
         return -1;
     }
     
+    // دیسک‌های قدیمی در همان محل و مرحله به مرحله ارتقا داده می‌شوند
+    if ((state->superblock->version == 3 && fs_upgrade_v3(state) != 0) ||
+        (state->superblock->version == 4 && fs_upgrade_v4(state) != 0) ||
+        (state->superblock->version == 5 && fs_upgrade_v5(state) != 0) ||
+        (state->superblock->version == 6 && fs_upgrade_v6(state) != 0) ||
+        (state->superblock->version == 7 && fs_upgrade_v7(state) != 0) ||
+        (state->superblock->version == 8 && fs_upgrade_v8(state) != 0)) {
+        munmap(state->data, FS_SIZE);
+        close(state->fd);
+        return -1;
+    }
+    
     if (state->superblock->version != VERSION) {
         fprintf(stderr, "Version mismatch: expected %u, got %u\n", 
                 VERSION, state->superblock->version);
@@ -173,81 +508,108 @@ int fs_disk_open(const char *disk_file, struct fs_state *state) {
     }
     
     // محاسبه آدرس جداول
-    state->user_table = (user_entry_t *)((char *)state->data + sizeof(superblock_t));
-    state->group_table = (group_entry_t *)((char *)state->data + sizeof(superblock_t) + 
-                                          (sizeof(user_entry_t) * MAX_USERS));
-    state->file_table = (file_entry_t *)((char *)state->data + sizeof(superblock_t) + 
-                                        (sizeof(user_entry_t) * MAX_USERS) +
-                                        (sizeof(group_entry_t) * MAX_GROUPS));
+    fs_map_tables(state);
     
-    printf("DEBUG: User table at %p\n", state->user_table);
-    printf("DEBUG: Group table at %p\n", state->group_table);
-    printf("DEBUG: File table at %p\n", state->file_table);
+    fs_log_debug("User table at %p", state->user_table);
+    fs_log_debug("Group table at %p", state->group_table);
+    fs_log_debug("File table: %u chunks, %u slots",
+                 state->superblock->chunk_count, fs_table_capacity(state));
     
-    // بازسازی لیست بلوک‌های خالی از دیسک
-    state->free_list = NULL;
+    // ساخت درخت‌های بلوک‌های خالی از bitmap دیسک (بدون پیمایش جدول فایل)
     fs_init_free_list(state);
     
+    // ساخت ایندکس هش نام فایل‌ها از روی جدول
+    if (fs_index_build(state) < 0 || fs_icache_init(state) < 0 ||
+        fs_slot_locks_grow(state, state->superblock->chunk_count) < 0) {
+        fprintf(stderr, "Failed to build file index\n");
+        munmap(state->data, FS_SIZE);
+        close(state->fd);
+        return -1;
+    }
+    
     // مقداردهی اولیه ACLها
-    state->file_acls = calloc(MAX_FILES, sizeof(acl_entry_t *));
+    state->file_acls = calloc(fs_table_capacity(state), sizeof(acl_entry_t *));
+    fs_pool_init(&state->acl_pool, sizeof(acl_entry_t));
+    
+    // داده فایل‌ها از mmap یا از کش بافر pread/pwrite
+    if (fs_bdev_open(state, disk_file) < 0) {
+        munmap(state->data, FS_SIZE);
+        close(state->fd);
+        return -1;
+    }
+    
+    // فایل‌های حذف شده‌ای که دفعه قبل هنوز باز بودند
+    fs_reclaim_orphans(state);
     
-    printf("General FS mounted successfully\n");
-    printf("Files: %u, Users: %u, Groups: %u\n", 
-           state->superblock->file_count,
-           state->superblock->user_count,
-           state->superblock->group_count);
+    fs_log_info("General FS mounted successfully");
+    fs_log_info("Files: %u, Users: %u, Groups: %u",
+                state->superblock->file_count,
+                state->superblock->user_count,
+                state->superblock->group_count);
     fs_print_free_list(state);
     return 0;
 }
 
 void fs_disk_close(struct fs_state *state) {
-    printf("DEBUG: Closing disk...\n");
+    fs_log_debug("Closing disk...");
+    
+    // بلوک‌های کثیف کش بافر قبل از هر چیز دیگر نوشته می‌شوند
+    fs_bdev_close(state);
+    
+    // پانچ بازه‌های باقی‌مانده در صف و بعد همه فضای خالی بزرگ
+    fs_discard_stop(state);
     
     // آزادسازی حافظه لیست بلوک‌های خالی
-    if (state->free_list) {
-        free_block_t *current = state->free_list;
-        while (current) {
-            free_block_t *next = current->next;
-            free(current);
-            current = next;
-        }
-        state->free_list = NULL;
-        printf("DEBUG: Free list memory freed\n");
+    if (state->alloc_group_count) {
+        fs_discard_sweep(state);
+        fs_free_list_destroy(state);
+        fs_log_debug("Free list memory freed");
     }
     
-    // آزادسازی حافظه ACLها
+    fs_index_free(state);
+    fs_icache_free(state);
+    
+    // آزادسازی حافظه ACLها (گره‌ها همه در acl_pool هستند)
     if (state->file_acls) {
-        for (uint32_t i = 0; i < MAX_FILES; i++) {
-            acl_entry_t *current = state->file_acls[i];
-            while (current) {
-                acl_entry_t *next = current->next;
-                free(current);
-                current = next;
-            }
-        }
+        fs_pool_destroy(&state->acl_pool);
         free(state->file_acls);
-        printf("DEBUG: ACL memory freed\n");
+        fs_log_debug("ACL memory freed");
     }
     
     if (state->data != NULL) {
         munmap(state->data, FS_SIZE);
-        printf("DEBUG: Memory unmapped\n");
+        fs_log_debug("Memory unmapped");
     }
     if (state->fd != -1) {
         close(state->fd);
-        printf("DEBUG: File closed\n");
+        fs_log_debug("File closed");
     }
+    fs_locks_destroy(state);
 }
 
 int main(int argc, char *argv[]) {
     // Register signal handler for debugging
     signal(SIGSEGV, signal_handler);
     
-    printf("DEBUG: Program started\n");
+    fs_log_debug("Program started");
     
     if (argc < 3) {
-        fprintf(stderr, "Usage: %s <disk_file> <mount_point> [FUSE options]\n", argv[0]);
+        fprintf(stderr, "Usage: %s <disk_file> <mount_point> [--lowlevel] [FUSE options]\n", argv[0]);
         fprintf(stderr, "Example: %s my_disk.bin /mnt/my_fs -f\n", argv[0]);
+        fprintf(stderr, "  --lowlevel - use the inode-based fuse_lowlevel frontend\n");
+        fprintf(stderr, "  -o entry_timeout=T,attr_timeout=T,negative_timeout=T - kernel cache timeouts (seconds)\n");
+        fprintf(stderr, "     (the commands below run on an unmounted image and do not invalidate a live mount's cache)\n");
+        fprintf(stderr, "  -o kernel_cache | -o auto_cache - keep page cache across opens\n");
+        fprintf(stderr, "  -o autodefrag - defragment small fragmented files when they are closed\n");
+        fprintf(stderr, "  -o copy_read - copy read data through a buffer instead of splicing from the image\n");
+        fprintf(stderr, "  -o copy_write - copy written data through a buffer instead of splicing into the image\n");
+        fprintf(stderr, "  -o relatime | -o strictatime | -o noatime - when reads update atime (default: relatime)\n");
+        fprintf(stderr, "  -o lazytime - keep timestamp-only updates in memory until the file is closed\n");
+        fprintf(stderr, "  -o log_level=error|warn|info|debug - log verbosity (default: info)\n");
+        fprintf(stderr, "  -o blockdev=mmap|pio - file data through the image mapping or pread/pwrite (default: mmap)\n");
+        fprintf(stderr, "  -o cache_mb=N - pio buffer cache size in MB (default: %d)\n", FS_CACHE_DEFAULT_MB);
+        fprintf(stderr, "  -o o_direct - pio with O_DIRECT, bypassing the host page cache\n");
+        fprintf(stderr, "  -s - single-threaded request loop (default: multithreaded)\n");
         fprintf(stderr, "\nAdditional commands after unmount:\n");
         fprintf(stderr, "  viz - visualize free space\n");
         fprintf(stderr, "  useradd <username> - add new user\n");
@@ -257,31 +619,18 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
-    printf("DEBUG: Arguments: disk_file=%s, mount_point=%s\n", argv[1], argv[2]);
+    fs_log_debug("Arguments: disk_file=%s, mount_point=%s", argv[1], argv[2]);
     
     fs_global_state = calloc(1, sizeof(struct fs_state));
     if (!fs_global_state) {
         perror("Failed to allocate state");
         return 1;
     }
-    printf("DEBUG: State allocated at %p\n", fs_global_state);
+    fs_log_debug("State allocated at %p", fs_global_state);
     
     fs_global_state->disk_file = argv[1];
     
-    if (access(fs_global_state->disk_file, F_OK) == 0) {
-        printf("DEBUG: Disk file exists, opening...\n");
-        if (fs_disk_open(fs_global_state->disk_file, fs_global_state) != 0) {
-            free(fs_global_state);
-            return 1;
-        }
-    } else {
-        printf("DEBUG: Disk file doesn't exist, creating...\n");
-        if (fs_disk_init(fs_global_state->disk_file, fs_global_state) != 0) {
-            free(fs_global_state);
-            return 1;
-        }
-    }
-    
+    // گزینه‌ها قبل از باز کردن دیسک خوانده می‌شوند تا سطح لاگ از همان ابتدا اعمال شود
     char *fuse_argv[argc + 2];
     int fuse_argc = 0;
     
@@ -290,21 +639,93 @@ int main(int argc, char *argv[]) {
     fuse_argv[fuse_argc++] = "-o";
     fuse_argv[fuse_argc++] = "allow_other,default_permissions";
     
+    int lowlevel = 0;
     for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--lowlevel") == 0) {
+            lowlevel = 1;
+            continue;
+        }
+        // -s به libfuse هم می‌رسد؛ read_buf سطح بالا باید بداند حلقه تک‌نخی است
+        if (strcmp(argv[i], "-s") == 0) {
+            fs_global_state->singlethread = 1;
+        }
         fuse_argv[fuse_argc++] = argv[i];
     }
     
     fuse_argv[fuse_argc] = NULL;
     
-    printf("DEBUG: Starting FUSE main...\n");
-    printf("Starting General FUSE filesystem...\n");
-    printf("Disk file: %s\n", fs_global_state->disk_file);
-    printf("Mount point: %s\n", argv[2]);
-    printf("Version: %u with user/group support\n", VERSION);
+    struct fuse_args args = FUSE_ARGS_INIT(fuse_argc, fuse_argv);
+    if (fs_parse_cache_opts(&args, &fs_global_state->cache) != 0) {
+        fprintf(stderr, "Invalid cache options\n");
+        fuse_opt_free_args(&args);
+        free(fs_global_state);
+        return 1;
+    }
+    if (fs_parse_defrag_opts(&args, &fs_global_state->defrag) != 0) {
+        fprintf(stderr, "Invalid defrag options\n");
+        fuse_opt_free_args(&args);
+        free(fs_global_state);
+        return 1;
+    }
+    if (fs_parse_splice_opts(&args, fs_global_state) != 0) {
+        fprintf(stderr, "Invalid splice options\n");
+        fuse_opt_free_args(&args);
+        free(fs_global_state);
+        return 1;
+    }
+    if (fs_parse_atime_opts(&args, fs_global_state) != 0) {
+        fprintf(stderr, "Invalid atime options\n");
+        fuse_opt_free_args(&args);
+        free(fs_global_state);
+        return 1;
+    }
+    if (fs_parse_log_opts(&args) != 0) {
+        fprintf(stderr, "Invalid log options\n");
+        fuse_opt_free_args(&args);
+        free(fs_global_state);
+        return 1;
+    }
+    if (fs_parse_bdev_opts(&args, &fs_global_state->bdev) != 0) {
+        fprintf(stderr, "Invalid block device options\n");
+        fuse_opt_free_args(&args);
+        free(fs_global_state);
+        return 1;
+    }
+    
+    if (access(fs_global_state->disk_file, F_OK) == 0) {
+        fs_log_debug("Disk file exists, opening...");
+        if (fs_disk_open(fs_global_state->disk_file, fs_global_state) != 0) {
+            fuse_opt_free_args(&args);
+            free(fs_global_state);
+            return 1;
+        }
+    } else {
+        fs_log_debug("Disk file doesn't exist, creating...");
+        if (fs_disk_init(fs_global_state->disk_file, fs_global_state) != 0) {
+            fuse_opt_free_args(&args);
+            free(fs_global_state);
+            return 1;
+        }
+    }
+    
+    fs_log_debug("Starting FUSE main...");
+    fs_log_info("Starting General FUSE filesystem...");
+    fs_log_info("Disk file: %s", fs_global_state->disk_file);
+    fs_log_info("Mount point: %s", argv[2]);
+    fs_log_info("Version: %u with user/group support", VERSION);
     
-    int ret = fuse_main(fuse_argc, fuse_argv, &fs_oper, NULL);
+    int ret;
+    if (lowlevel) {
+        fs_log_info("Frontend: fuse_lowlevel (inode based)");
+        ret = fs_lowlevel_main(args.argc, args.argv, fs_global_state);
+    } else {
+        ret = fuse_main(args.argc, args.argv, &fs_oper, NULL);
+    }
+    fuse_opt_free_args(&args);
     
-    printf("DEBUG: FUSE main returned: %d\n", ret);
+    // پیام‌های باقی‌مانده نوشته می‌شوند؛ خروجی بعد از این مستقیم است
+    fs_log_stop();
+    fs_log_debug("FUSE main returned: %d", ret);
     
     // پس از جدا کردن فایل سیستم، فضای خالی را نمایش می‌دهیم
     if (fs_global_state) {
@@ -19,7 +19,7 @@ int fs_chmod(const char *path, mode_t mode, struct fs_state *state) {
     }
     
     file->permissions = mode & 0777;  // فقط 9 بیت آخر
-    file->mtime = time(NULL);
+    file->mtime = fs_now();
     
     printf("Permissions changed for %s: %o\n", path, file->permissions);
     return 0;
@@ -57,7 +57,7 @@ int fs_chown(const char *path, uint32_t uid, uint32_t gid, struct fs_state *stat
         file->gid = gid;
     }
     
-    file->ctime = time(NULL);
+    file->ctime = fs_now();
     
     printf("Ownership changed for %s: UID=%u, GID=%u\n", path, file->uid, file->gid);
     return 0;
@@ -0,0 +1,74 @@
+#include "general_fs.h"
+#include <stdio.h>
+
+// تخصیص‌دهنده اشیای هم‌اندازه: تکه‌های بزرگ از malloc گرفته می‌شوند و اشیا
+// پشت سر هم از آن‌ها بریده می‌شوند؛ اشیای آزاد شده در یک لیست داخلی برمی‌گردند
+// و همه تکه‌ها یکجا در fs_pool_destroy آزاد می‌شوند
+
+// فاصله اولین شیء از ابتدای تکه (هم‌ترازی برای هر نوع داده)
+#define POOL_HEADER ((sizeof(fs_pool_chunk_t) + 15) & ~(size_t)15)
+
+void fs_pool_init(fs_pool_t *pool, size_t object_size) {
+    memset(pool, 0, sizeof(*pool));
+
+    // هر شیء آزاد یک اشاره‌گر به شیء آزاد بعدی را در خودش نگه می‌دارد
+    if (object_size < sizeof(void *)) {
+        object_size = sizeof(void *);
+    }
+    pool->object_size = (object_size + 7) & ~(size_t)7;
+    pool->per_chunk = (FS_POOL_CHUNK_BYTES - POOL_HEADER) / pool->object_size;
+}
+
+// یک شیء صفر شده، یا NULL اگر حافظه نباشد
+void *fs_pool_alloc(fs_pool_t *pool) {
+    void *object = pool->free_objects;
+
+    if (object) {
+        pool->free_objects = *(void **)object;
+    } else {
+        if (pool->bump == pool->bump_end) {
+            fs_pool_chunk_t *chunk = malloc(FS_POOL_CHUNK_BYTES);
+            if (!chunk) {
+                return NULL;
+            }
+            chunk->next = pool->chunks;
+            pool->chunks = chunk;
+            pool->chunk_count++;
+            pool->bump = (char *)chunk + POOL_HEADER;
+            pool->bump_end = pool->bump + pool->per_chunk * pool->object_size;
+        }
+        object = pool->bump;
+        pool->bump += pool->object_size;
+    }
+
+    pool->in_use++;
+    memset(object, 0, pool->object_size);
+    return object;
+}
+
+// برگرداندن شیء به لیست آزاد (حافظه تا fs_pool_destroy در pool می‌ماند)
+void fs_pool_free(fs_pool_t *pool, void *object) {
+    if (!object) return;
+
+    *(void **)object = pool->free_objects;
+    pool->free_objects = object;
+    pool->in_use--;
+}
+
+// آزادسازی همه تکه‌ها؛ اشیای باقی‌مانده دیگر معتبر نیستند
+void fs_pool_destroy(fs_pool_t *pool) {
+    fs_pool_chunk_t *chunk = pool->chunks;
+    while (chunk) {
+        fs_pool_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    // اندازه اشیا حفظ می‌شود تا pool دوباره قابل استفاده باشد
+    pool->chunks = NULL;
+    pool->chunk_count = 0;
+    pool->free_objects = NULL;
+    pool->bump = NULL;
+    pool->bump_end = NULL;
+    pool->in_use = 0;
+}
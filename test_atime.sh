@@ -0,0 +1,95 @@
+#!/bin/bash
+
+echo "=== Testing atime Modes (relatime/strictatime/noatime, lazytime) ==="
+echo "===================================================================="
+
+make
+
+MNT=/tmp/atime_test
+
+echo -e "\n1. Setting up test environment..."
+rm -f atime.bin
+rm -rf $MNT
+mkdir -p $MNT
+
+mount_fs() {
+    ./general_fs atime.bin $MNT -f $@ &
+    FS_PID=$!
+    sleep 3
+}
+
+unmount_fs() {
+    fusermount -u $MNT
+    wait $FS_PID
+}
+
+# آیا atime با cat اول و با cat دوم (یک ثانیه بعد) عوض می‌شود؛ قبل از آن
+# atime قدیمی‌تر از mtime و ctime است
+atime_changes() {
+    touch -a -d "1 hour ago" $MNT/file.txt
+    sleep 1.5  # کش attr کرنل
+    local t0=$(stat -c %X $MNT/file.txt)
+    cat $MNT/file.txt > /dev/null
+    sleep 1.5
+    local t1=$(stat -c %X $MNT/file.txt)
+    cat $MNT/file.txt > /dev/null
+    sleep 1.5
+    local t2=$(stat -c %X $MNT/file.txt)
+    echo "$([ $t0 != $t1 ] && echo 1 || echo 0) $([ $t1 != $t2 ] && echo 1 || echo 0)"
+}
+
+mount_fs
+echo "atime test" > $MNT/file.txt
+unmount_fs
+
+echo -e "\n2. Read updates atime only when needed..."
+for mode in "relatime:1 0" "strictatime:1 1" "noatime:0 0"; do
+    name=${mode%%:*}
+    expect=${mode#*:}
+
+    mount_fs -o $name
+    changed=$(atime_changes)
+    [ "$changed" = "$expect" ] && echo "✓ $name: atime changed on reads: $changed" || echo "✗ $name: atime changed on reads: $changed, expected $expect"
+    unmount_fs
+done
+
+echo -e "\n3. lazytime keeps mtime of an in-place write until close..."
+mount_fs --lowlevel -o lazytime
+touch -m -d "1 hour ago" $MNT/file.txt
+before=$(stat -c %Y $MNT/file.txt)
+# بازنویسی بدون تغییر اندازه؛ فایل تا پایان exec باز می‌ماند
+(
+    exec 3<>$MNT/file.txt
+    printf 'ATIME' >&3
+    sleep 1.5
+    [ "$(stat -c %Y $MNT/file.txt)" != "$before" ] && echo "✓ New mtime visible while open" || echo "✗ mtime not visible while open"
+)
+sleep 1.5
+[ "$(stat -c %Y $MNT/file.txt)" != "$before" ] && echo "✓ mtime kept after close" || echo "✗ mtime lost after close"
+unmount_fs
+
+mount_fs
+[ "$(stat -c %Y $MNT/file.txt)" != "$before" ] && echo "✓ mtime persisted across remount" || echo "✗ mtime not persisted"
+unmount_fs
+
+echo -e "\n4. lazytime + relatime: read after an in-place write updates atime..."
+mount_fs --lowlevel -o lazytime,relatime
+(
+    exec 3<>$MNT/file.txt
+    cat $MNT/file.txt > /dev/null
+    sleep 1.5
+    # mtime جدید فقط در inode است؛ relatime باید آن را ببیند
+    printf 'LAZY' >&3
+    sleep 1.5
+    t0=$(stat -c %X $MNT/file.txt)
+    cat $MNT/file.txt > /dev/null
+    sleep 1.5
+    [ "$(stat -c %X $MNT/file.txt)" != "$t0" ] && echo "✓ atime updated by read after write" || echo "✗ atime not updated by read after write"
+)
+unmount_fs
+
+echo -e "\n5. Cleanup..."
+rm -f atime.bin
+rm -rf $MNT
+
+echo -e "\n✅ atime tests completed!"
@@ -0,0 +1,56 @@
+#!/bin/bash
+
+echo "=== Testing Block Device Backends (mmap, pio + buffer cache) ==="
+echo "================================================================"
+
+make
+
+MNT=/tmp/blockdev_test
+
+echo -e "\n1. Setting up test environment..."
+rm -f blockdev.bin data.src
+rm -rf $MNT
+mkdir -p $MNT
+head -c $((40 * 1024 * 1024)) /dev/urandom > data.src
+SUM=$(md5sum < data.src)
+
+mount_fs() {
+    ./general_fs blockdev.bin $MNT -f $@ &
+    FS_PID=$!
+    sleep 3
+}
+
+unmount_fs() {
+    fusermount -u $MNT
+    wait $FS_PID
+}
+
+rss_kb() {
+    grep VmRSS /proc/$FS_PID/status | awk '{print $2}'
+}
+
+echo -e "\n2. pio with a 4 MB cache: 40 MB file round trip..."
+mount_fs -o blockdev=pio,cache_mb=4
+cp data.src $MNT/big.bin
+[ "$(md5sum < $MNT/big.bin)" = "$SUM" ] && echo "✓ Data matches while mounted" || echo "✗ Data mismatch while mounted"
+# کش ثابت است؛ داده فایل از mmap رد نمی‌شود
+echo "RSS after 40 MB through a 4 MB cache: $(rss_kb) KB"
+unmount_fs
+
+echo -e "\n3. Dirty blocks reached the image (remount with mmap)..."
+mount_fs -o blockdev=mmap
+[ "$(md5sum < $MNT/big.bin)" = "$SUM" ] && echo "✓ Data persisted" || echo "✗ Data lost"
+echo "RSS after reading 40 MB with mmap: $(rss_kb) KB"
+unmount_fs
+
+echo -e "\n4. O_DIRECT (falls back to buffered I/O where unsupported)..."
+mount_fs --lowlevel -o o_direct,cache_mb=1
+dd if=data.src of=$MNT/big.bin bs=1M count=8 skip=4 seek=4 conv=notrunc status=none
+[ "$(md5sum < $MNT/big.bin)" = "$SUM" ] && echo "✓ In-place rewrite kept data" || echo "✗ In-place rewrite corrupted data"
+unmount_fs
+
+echo -e "\n5. Cleanup..."
+rm -f blockdev.bin data.src
+rm -rf $MNT
+
+echo -e "\n✅ Block device tests completed!"
@@ -0,0 +1,44 @@
+#!/bin/bash
+
+echo "=== Testing Nested Directories ==="
+echo "==================================="
+
+make clean
+make
+
+echo -e "\n1. Setting up test environment..."
+rm -f dirs.bin
+rm -rf /tmp/dirs_test
+mkdir -p /tmp/dirs_test
+
+echo -e "\n2. Starting filesystem..."
+./general_fs dirs.bin /tmp/dirs_test -f &
+FS_PID=$!
+sleep 3
+
+echo -e "\n3. Creating nested tree..."
+mkdir /tmp/dirs_test/a && echo "✓ mkdir a" || echo "✗ mkdir a"
+mkdir /tmp/dirs_test/a/b && echo "✓ mkdir a/b" || echo "✗ mkdir a/b"
+echo "deep" > /tmp/dirs_test/a/b/file.txt && echo "✓ create a/b/file.txt" || echo "✗ create a/b/file.txt"
+echo "top" > /tmp/dirs_test/file.txt && echo "✓ create file.txt (same name, other dir)" || echo "✗ create file.txt"
+
+echo -e "\n4. Checking lookups..."
+grep -q "deep" /tmp/dirs_test/a/b/file.txt && echo "✓ a/b/file.txt has its own content" || echo "✗ a/b/file.txt content"
+grep -q "top" /tmp/dirs_test/file.txt && echo "✓ file.txt has its own content" || echo "✗ file.txt content"
+
+echo -e "\n5. Checking listings..."
+[ "$(ls /tmp/dirs_test)" = "$(printf 'a\nfile.txt')" ] && echo "✓ root lists only its children" || echo "✗ root listing"
+[ "$(ls /tmp/dirs_test/a)" = "b" ] && echo "✓ a lists only b" || echo "✗ a listing"
+
+echo -e "\n6. Checking rmdir..."
+rmdir /tmp/dirs_test/a 2>/dev/null && echo "✗ rmdir of non-empty dir succeeded" || echo "✓ rmdir of non-empty dir refused"
+rm /tmp/dirs_test/a/b/file.txt && rmdir /tmp/dirs_test/a/b && rmdir /tmp/dirs_test/a && echo "✓ tree removed" || echo "✗ tree removal"
+
+echo -e "\n7. Unmounting and cleanup..."
+fusermount -u /tmp/dirs_test
+wait $FS_PID
+
+rm -f dirs.bin
+rm -rf /tmp/dirs_test
+
+echo -e "\n✅ Directory tests completed!"
@@ -0,0 +1,77 @@
+#!/bin/bash
+
+echo "=== Testing Free Space Across Remounts ==="
+echo "==========================================="
+
+make
+
+echo -e "\n1. Setting up test environment..."
+rm -f remount.bin
+rm -rf /tmp/remount_test
+mkdir -p /tmp/remount_test
+
+echo -e "\n2. Creating files and leaving holes..."
+./general_fs remount.bin /tmp/remount_test -f &
+FS_PID=$!
+sleep 3
+
+for i in $(seq 1 30); do
+    head -c 3000 /dev/zero | tr '\0' 'a' > /tmp/remount_test/old_$i
+done
+for i in $(seq 1 30 | awk '$1 % 3 == 0'); do
+    rm /tmp/remount_test/old_$i
+done
+
+fusermount -u /tmp/remount_test
+wait $FS_PID
+
+echo -e "\n3. Remounting and writing new files..."
+./general_fs remount.bin /tmp/remount_test -f &
+FS_PID=$!
+sleep 3
+
+for i in $(seq 1 30); do
+    head -c 3000 /dev/zero | tr '\0' 'b' > /tmp/remount_test/new_$i
+done
+
+# داده فایل‌های قدیمی نباید با فایل‌های جدید بازنویسی شده باشد
+BROKEN=0
+for f in /tmp/remount_test/old_*; do
+    if [ "$(tr -d 'a' < $f | wc -c)" != "0" ]; then
+        echo "✗ $f was overwritten"
+        BROKEN=1
+    fi
+done
+[ $BROKEN -eq 0 ] && echo "✓ Old files intact after remount"
+
+fusermount -u /tmp/remount_test
+wait $FS_PID
+
+echo -e "\n4. Unlinked file stays usable while open (lowlevel)..."
+./general_fs remount.bin /tmp/remount_test --lowlevel -f &
+FS_PID=$!
+sleep 3
+
+echo "first" > /tmp/remount_test/open.txt
+exec 3<>/tmp/remount_test/open.txt
+rm /tmp/remount_test/open.txt
+[ ! -e /tmp/remount_test/open.txt ] && echo "✓ Name removed" || echo "✗ Name still visible"
+# خواندن و نوشتن از fd 3 بعد از rm (نوشتن بعد از خواندن به انتهای فایل می‌رود)
+[ "$(head -n 1 <&3)" = "first" ] && echo "✓ Read through open fd after rm" || echo "✗ Read through open fd failed"
+echo "second" >&3 && echo "✓ Write through open fd after rm" || echo "✗ Write through open fd failed"
+[ "$(cat /proc/self/fd/3)" = "$(printf 'first\nsecond')" ] && echo "✓ Data written after rm is readable" || echo "✗ Data written after rm lost"
+exec 3>&-
+
+# اسلات و بلوک‌ها با بستن fd آزاد شده‌اند؛ فایل‌های قبلی دست نخورده‌اند
+for f in /tmp/remount_test/new_*; do
+    [ "$(tr -d 'b' < $f | wc -c)" = "0" ] || echo "✗ $f was overwritten"
+done
+
+fusermount -u /tmp/remount_test
+wait $FS_PID
+
+echo -e "\n5. Cleanup..."
+rm -f remount.bin
+rm -rf /tmp/remount_test
+
+echo -e "\n✅ Remount tests completed!"
@@ -0,0 +1,76 @@
+#!/bin/bash
+
+echo "=== Testing Concurrent Access (multithreaded FUSE) ==="
+echo "======================================================"
+
+make
+
+THREADS=${THREADS:-8}
+FILE_MB=${FILE_MB:-8}
+
+echo -e "\n1. Setting up test environment..."
+rm -f stress.bin
+rm -rf /tmp/stress_test /tmp/stress_src
+mkdir -p /tmp/stress_test /tmp/stress_src
+
+for i in $(seq 1 $THREADS); do
+    head -c $((FILE_MB * 1024 * 1024)) /dev/urandom > /tmp/stress_src/file_$i
+done
+
+# هر پروسه فایل خودش را می‌نویسد، می‌خواند و با منبع مقایسه می‌کند؛
+# هم‌زمان یک پروسه دیگر دایرکتوری را فهرست و فایل موقت می‌سازد و حذف می‌کند
+run_load() {
+    local pids=""
+    for i in $(seq 1 $THREADS); do
+        (
+            cp /tmp/stress_src/file_$i /tmp/stress_test/file_$i &&
+            cmp -s /tmp/stress_src/file_$i /tmp/stress_test/file_$i &&
+            rm /tmp/stress_test/file_$i
+        ) &
+        pids="$pids $!"
+    done
+    (
+        for j in $(seq 1 200); do
+            ls -l /tmp/stress_test > /dev/null
+            echo $j > /tmp/stress_test/tmp_$j && rm /tmp/stress_test/tmp_$j
+        done
+    ) &
+    pids="$pids $!"
+
+    local failed=0
+    for pid in $pids; do
+        wait $pid || failed=1
+    done
+    return $failed
+}
+
+for mode in "multithreaded:" "single-threaded:-s"; do
+    name=${mode%%:*}
+    flags=${mode#*:}
+
+    echo -e "\n2. Mounting lowlevel frontend ($name)..."
+    rm -f stress.bin
+    ./general_fs stress.bin /tmp/stress_test --lowlevel -f $flags &
+    FS_PID=$!
+    sleep 3
+
+    START=$(date +%s.%N)
+    if run_load; then
+        echo "✓ $THREADS parallel writers/readers verified ($name)"
+    else
+        echo "✗ Data mismatch or failed operation ($name)"
+    fi
+    END=$(date +%s.%N)
+    echo "  $name: $(echo "$END - $START" | bc) s for $((THREADS * FILE_MB)) MB"
+
+    [ "$(ls /tmp/stress_test | wc -l)" = "0" ] && echo "✓ All files removed ($name)"
+
+    fusermount -u /tmp/stress_test
+    wait $FS_PID
+done
+
+echo -e "\n3. Cleanup..."
+rm -f stress.bin
+rm -rf /tmp/stress_test /tmp/stress_src
+
+echo -e "\n✅ Stress tests completed!"
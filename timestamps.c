@@ -0,0 +1,119 @@
+#include "general_fs.h"
+#include <stdio.h>
+
+// زمان‌های فایل. entryها مستقیم در mmap مشترک image هستند، پس هر نوشتن
+// زمان یک صفحه متادیتا را کثیف می‌کند و به writeback جدول فایل می‌رسد:
+//   ساعت: CLOCK_REALTIME_COARSE که کرنل هر tick یک بار به‌روز می‌کند و از vDSO
+//     بدون syscall خوانده می‌شود؛ دقت ثانیه entry بیشتر از آن نیست
+//   مقداری که تغییر نکرده (همان ثانیه) دوباره نوشته نمی‌شود
+//   atime: relatime (پیش‌فرض)، strictatime یا noatime؛ open دیگر atime نمی‌نویسد
+//   lazytime: وقتی زمان تنها تغییر entry است (خواندن، یا نوشتن داخل فایل بدون
+//     تغییر اندازه و بلوک‌ها) در inode حافظه handle نگه داشته می‌شود و در release،
+//     یا همراه اولین تغییر دیگر entry، نوشته می‌شود. getattr سطح پایین و fstat آن
+//     را می‌بینند؛ stat مسیر در frontend سطح بالا زمان نوشته شده را نشان می‌دهد
+
+uint32_t fs_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    return (uint32_t)now.tv_sec;
+}
+
+static uint32_t max_time(uint32_t a, uint32_t b) {
+    return a > b ? a : b;
+}
+
+// بعد از خواندن؛ خواندن‌های هم‌زمان زیر قفل اشتراکی اسلات فقط atime را
+// (در entry یا inode) می‌نویسند
+void fs_touch_atime(struct fs_state *state, file_entry_t *entry, fs_inode_t *inode) {
+    if (state->atime_mode == FS_ATIME_NOATIME) {
+        return;
+    }
+
+    uint32_t now = fs_now();
+    uint32_t atime = __atomic_load_n(&entry->atime, __ATOMIC_RELAXED);
+    uint32_t mtime = entry->mtime;
+    if (inode) {
+        // با lazytime آخرین mtime ممکن است فقط در inode باشد
+        atime = max_time(atime, __atomic_load_n(&inode->lazy_atime, __ATOMIC_RELAXED));
+        mtime = fs_lazytime_mtime(entry, inode);
+    }
+
+    if (atime == now) {
+        return;
+    }
+    if (state->atime_mode == FS_ATIME_RELATIME && atime > mtime &&
+        atime > entry->ctime && atime + FS_RELATIME_SECONDS > now) {
+        return;
+    }
+
+    if (state->lazytime && inode) {
+        __atomic_store_n(&inode->lazy_atime, now, __ATOMIC_RELAXED);
+    } else {
+        __atomic_store_n(&entry->atime, now, __ATOMIC_RELAXED);
+    }
+}
+
+// بعد از نوشتن (زیر قفل انحصاری اسلات)؛ dirty یعنی اندازه یا بلوک‌های entry
+// هم تغییر کرده و صفحه آن به هر حال کثیف است
+void fs_touch_mtime(struct fs_state *state, file_entry_t *entry, fs_inode_t *inode, int dirty) {
+    uint32_t now = fs_now();
+
+    if (state->lazytime && inode && !dirty) {
+        if (max_time(entry->mtime, inode->lazy_mtime) != now) {
+            __atomic_store_n(&inode->lazy_mtime, now, __ATOMIC_RELAXED);
+        }
+        return;
+    }
+
+    fs_lazytime_flush(entry, inode);
+    if (entry->mtime != now) {
+        entry->mtime = now;
+    }
+}
+
+// نوشتن زمان‌های معوق inode در entry (زیر قفل انحصاری اسلات)
+// زمانی که entry از آن جلوتر است (مثلاً بعد از truncate) عقب نمی‌رود
+void fs_lazytime_flush(file_entry_t *entry, fs_inode_t *inode) {
+    if (!inode) return;
+
+    uint32_t atime = __atomic_load_n(&inode->lazy_atime, __ATOMIC_RELAXED);
+    if (atime > entry->atime) {
+        __atomic_store_n(&entry->atime, atime, __ATOMIC_RELAXED);
+    }
+    if (inode->lazy_mtime > entry->mtime) {
+        entry->mtime = inode->lazy_mtime;
+    }
+    __atomic_store_n(&inode->lazy_atime, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&inode->lazy_mtime, 0, __ATOMIC_RELAXED);
+}
+
+// همان برای اسلاتی که handle آن در دست نیست (utimens سطح بالا)؛ بعد از آن
+// زمان صریح روی entry نوشته می‌شود و release بعدی آن را برنمی‌گرداند
+void fs_lazytime_flush_slot(struct fs_state *state, uint32_t slot) {
+    if (!state->lazytime) return;
+
+    pthread_mutex_lock(&state->icache_lock);
+    fs_inode_t *inode = state->inodes[slot];
+    if (inode) {
+        fs_lazytime_flush(fs_entry(state, slot), inode);
+    }
+    pthread_mutex_unlock(&state->icache_lock);
+}
+
+// mtime واقعی فایل با احتساب زمان معوق (برای auto_cache)
+uint32_t fs_lazytime_mtime(file_entry_t *entry, fs_inode_t *inode) {
+    return max_time(entry->mtime, __atomic_load_n(&inode->lazy_mtime, __ATOMIC_RELAXED));
+}
+
+// اعمال زمان‌های معوق روی نتیجه getattr
+void fs_lazytime_stat(fs_inode_t *inode, struct stat *stbuf) {
+    uint32_t atime = __atomic_load_n(&inode->lazy_atime, __ATOMIC_RELAXED);
+    uint32_t mtime = __atomic_load_n(&inode->lazy_mtime, __ATOMIC_RELAXED);
+
+    if (atime > stbuf->st_atime) {
+        stbuf->st_atime = atime;
+    }
+    if (mtime > stbuf->st_mtime) {
+        stbuf->st_mtime = mtime;
+    }
+}